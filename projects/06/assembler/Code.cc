@@ -0,0 +1,151 @@
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+using namespace std;
+
+// Code
+// comp/dest/jump mnemonics are at most 3 characters, so each one packs
+// into a single integer key. The tables are perfect hashes over those keys
+// with the multiplier searched for at compile time.
+struct CodeEntry {
+    string_view mnemonic;
+    uint16_t bits;
+};
+
+constexpr uint32_t packMnemonic(string_view s) {
+    uint32_t key = s.size() << 24;
+    for (size_t i = 0; i < s.size(); i++) {
+        key |= uint32_t(uint8_t(s[i])) << (8 * i);
+    }
+    return key;
+}
+
+template <size_t N, int Bits>
+class PerfectHash {
+private:
+  static constexpr size_t Size = size_t(1) << Bits;
+  static constexpr uint32_t EMPTY = 0xFFFFFFFF;
+
+  array<uint32_t, Size> keys{};
+  array<uint16_t, Size> values{};
+  uint32_t seed = 0;
+
+  static constexpr size_t slot(uint32_t key, uint32_t seed) {
+      return (key * seed) >> (32 - Bits);
+  }
+
+  constexpr bool tryBuild(const array<CodeEntry, N>& entries, uint32_t candidate) {
+      keys.fill(EMPTY);
+      for (const CodeEntry& e : entries) {
+          uint32_t key = packMnemonic(e.mnemonic);
+          size_t i = slot(key, candidate);
+          if (keys[i] != EMPTY) {
+              return false;
+          }
+          keys[i] = key;
+          values[i] = e.bits;
+      }
+      seed = candidate;
+      return true;
+  }
+
+public:
+    constexpr PerfectHash(const array<CodeEntry, N>& entries) {
+        // odd multipliers only, spread out by a golden-ratio step
+        for (uint32_t candidate = 0x9E3779B1; ; candidate += 0x9E3779B9 * 2) {
+            if (tryBuild(entries, candidate | 1)) {
+                return;
+            }
+        }
+    }
+
+    // bit field for the mnemonic, -1 when unknown
+    constexpr int find(string_view mnemonic) const {
+        if (mnemonic.size() > 3) {
+            return -1;
+        }
+        uint32_t key = packMnemonic(mnemonic);
+        size_t i = slot(key, seed);
+        return keys[i] == key ? values[i] : -1;
+    }
+};
+
+constexpr array<CodeEntry, 8> destEntries = {{
+      {"",    0b000},
+      {"M",   0b001},
+      {"D",   0b010},
+      {"MD",  0b011},
+      {"A",   0b100},
+      {"AM",  0b101},
+      {"AD",  0b110},
+      {"AMD", 0b111}
+}};
+
+constexpr array<CodeEntry, 8> jumpEntries = {{
+      {"",    0b000},
+      {"JGT", 0b001},
+      {"JEQ", 0b010},
+      {"JGE", 0b011},
+      {"JLT", 0b100},
+      {"JNE", 0b101},
+      {"JLE", 0b110},
+      {"JMP", 0b111}
+}};
+
+constexpr array<CodeEntry, 34> compEntries = {{
+      {"0",   0b0101010},
+      {"1",   0b0111111},
+      {"-1",  0b0111010},
+      {"D",   0b0001100},
+      {"A",   0b0110000},
+      {"M",   0b1110000},
+      {"!D",  0b0001101},
+      {"!A",  0b0110001},
+      {"!M",  0b1110001},
+      {"-D",  0b0001111},
+      {"-A",  0b0110011},
+      {"-M",  0b1110011},
+      {"D+1", 0b0011111},
+      {"A+1", 0b0110111},
+      {"M+1", 0b1110111},
+      {"D-1", 0b0001110},
+      {"A-1", 0b0110010},
+      {"M-1", 0b1110010},
+      {"D+A", 0b0000010},
+      {"D+M", 0b1000010},
+      {"D-A", 0b0010011},
+      {"D-M", 0b1010011},
+      {"A-D", 0b0000111},
+      {"M-D", 0b1000111},
+      {"D&A", 0b0000000},
+      {"D&M", 0b1000000},
+      {"D|A", 0b0010101},
+      {"D|M", 0b1010101},
+
+      // commutative forms, emitted by the VM translator
+      {"M+D", 0b1000010},
+      {"A+D", 0b0000010},
+      {"M&D", 0b1000000},
+      {"A&D", 0b0000000},
+      {"M|D", 0b1010101},
+      {"A|D", 0b0010101}
+}};
+
+constexpr PerfectHash<8, 4> destCode(destEntries);
+constexpr PerfectHash<8, 4> jumpCode(jumpEntries);
+constexpr PerfectHash<34, 6> compCode(compEntries);
+
+static_assert(compCode.find("D|M") == 0b1010101);
+static_assert(destCode.find("") == 0 && jumpCode.find("JMP") == 0b111);
+static_assert(compCode.find("D+D") == -1);
+
+template <size_t N, int Bits>
+uint16_t lookupCode(const PerfectHash<N, Bits>& table, string_view mnemonic) {
+    int bits = table.find(mnemonic);
+    if (bits < 0) {
+        throw invalid_argument("unknown mnemonic: " + string(mnemonic));
+    }
+    return bits;
+}
@@ -0,0 +1,81 @@
+#include <ostream>
+#include <string_view>
+using namespace std;
+
+// class
+enum InstructionType {
+    I_A,
+    I_C,
+    I_LABEL, // (xxx), only kept in the stream for the optimizer
+};
+
+class Instruction {
+  friend class PeepholeOptimizer;
+
+  InstructionType type;
+  string_view addr; // or label name
+  string_view dest;
+  string_view comp;
+  string_view jump;
+
+public:
+    Instruction(string_view addr): type(I_A), addr(addr) {}
+    Instruction(string_view dest, string_view comp, string_view jump): type(I_C), dest(dest), comp(comp), jump(jump) {}
+
+    static Instruction label(string_view name) {
+        Instruction ins(name);
+        ins.type = I_LABEL;
+        return ins;
+    }
+
+    bool isLabel() const {
+        return type == I_LABEL;
+    }
+
+    string_view labelName() const {
+        return addr;
+    }
+
+    uint16_t encode(SymbolTable& st) const {
+        if (type == I_A) {
+            return st.getOrMalloc(addr) & 0x7FFF;
+        } else {
+            return encodeC();
+        }
+    }
+
+    uint16_t encodeC() const {
+        return 0xE000
+            | lookupCode(compCode, comp) << 6
+            | lookupCode(destCode, dest) << 3
+            | lookupCode(jumpCode, jump);
+    }
+
+    // text is a T_C token: [dest=]comp[;jump]
+    static Instruction parse(string_view text) {
+        string_view dest, jump;
+        size_t eq = text.find('=');
+        if (eq != string_view::npos) {
+            dest = text.substr(0, eq);
+            text.remove_prefix(eq + 1);
+        }
+        size_t semi = text.find(';');
+        if (semi != string_view::npos) {
+            jump = text.substr(semi + 1);
+            text = text.substr(0, semi);
+        }
+        return Instruction(dest, text, jump);
+    }
+
+    friend ostream& operator<<(ostream &os, const Instruction& ins) {
+        if (ins.type == I_A) {
+            os << "@" << ins.addr;
+        } else if (ins.type == I_LABEL) {
+            os << "(" << ins.addr << ")";
+        } else {
+            os << ins.dest << "=" << ins.comp << ";" << ins.jump;
+        }
+        return os;
+    }
+};
+
@@ -0,0 +1,103 @@
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include "./MappedFile.cc"
+using namespace std;
+
+// character classes
+enum CharClass : uint8_t {
+    CC_OTHER   = 0,
+    CC_HACK    = 1 << 0, // may appear inside a symbol or an instruction
+    CC_DIGIT   = 1 << 1,
+};
+
+constexpr array<uint8_t, 256> makeCharClasses() {
+    array<uint8_t, 256> table{};
+    for (int c = 'a'; c <= 'z'; c++) table[c] |= CC_HACK;
+    for (int c = 'A'; c <= 'Z'; c++) table[c] |= CC_HACK;
+    for (int c = '0'; c <= '9'; c++) table[c] |= CC_HACK | CC_DIGIT;
+    for (char c : string_view("+-;=@.$_!&|")) {
+        table[static_cast<uint8_t>(c)] |= CC_HACK;
+    }
+    return table;
+}
+
+constexpr array<uint8_t, 256> charClasses = makeCharClasses();
+
+inline bool isHackChar(char c) {
+    return charClasses[static_cast<uint8_t>(c)] & CC_HACK;
+}
+
+inline bool isDigitChar(char c) {
+    return charClasses[static_cast<uint8_t>(c)] & CC_DIGIT;
+}
+
+// Lexer
+enum TokenType {
+    T_A,     // @xxx, text is xxx
+    T_C,     // dest=comp;jump
+    T_LABEL, // (xxx), text is xxx
+    T_EOF
+};
+
+struct Token {
+    TokenType type;
+    string_view text;
+};
+
+class Lexer {
+private:
+  string_view buffer;
+  size_t pos = 0;
+
+  string_view scanRun() {
+      size_t start = pos;
+      while (pos < buffer.size() && isHackChar(buffer[pos])) {
+          pos++;
+      }
+      return buffer.substr(start, pos - start);
+  }
+
+public:
+    Lexer(string_view buffer): buffer(buffer) {}
+
+    Token next() {
+        while (pos < buffer.size()) {
+            char c = buffer[pos];
+
+            // assuming no divid character
+            if (c == '/') {
+                size_t eol = buffer.find('\n', pos);
+                pos = eol == string_view::npos ? buffer.size() : eol + 1;
+                continue;
+            }
+
+            if (c == '(') {
+                pos++;
+                // ( LOOP ) names LOOP, the run stops before the closing spaces
+                while (pos < buffer.size() && (buffer[pos] == ' ' || buffer[pos] == '\t')) {
+                    pos++;
+                }
+                string_view symbol = scanRun();
+                size_t close = buffer.find(')', pos);
+                pos = close == string_view::npos ? buffer.size() : close + 1;
+                return {T_LABEL, symbol};
+            }
+
+            if (c == '@') {
+                pos++;
+                return {T_A, scanRun()};
+            }
+
+            if (isHackChar(c)) {
+                return {T_C, scanRun()};
+            }
+
+            pos++;
+        }
+
+        return {T_EOF, string_view()};
+    }
+};
@@ -0,0 +1,67 @@
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+// MappedFile
+// maps the whole input read-only, falls back to reading it into memory
+// (pipes, empty files, filesystems without mmap)
+class MappedFile {
+private:
+  const char* data = nullptr;
+  size_t size = 0;
+  bool mapped = false;
+  bool opened = false;
+  string fallback;
+
+public:
+    MappedFile(const string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0) {
+            struct stat sb;
+            if (fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) && sb.st_size > 0) {
+                void* p = mmap(nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    data = static_cast<const char*>(p);
+                    size = sb.st_size;
+                    mapped = true;
+                    opened = true;
+                    madvise(p, size, MADV_SEQUENTIAL);
+                }
+            }
+            close(fd);
+        }
+
+        if (!mapped) {
+            ifstream file(path, ios::binary);
+            if (file.is_open()) {
+                fallback.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+                data = fallback.data();
+                size = fallback.size();
+                opened = true;
+            }
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (mapped) {
+            munmap(const_cast<char*>(data), size);
+        }
+    }
+
+    bool is_open() const {
+        return opened;
+    }
+
+    string_view view() const {
+        return string_view(data, size);
+    }
+};
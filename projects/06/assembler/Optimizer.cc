@@ -0,0 +1,251 @@
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// PeepholeOptimizer
+// Rewrites the parsed instruction stream before label addresses are
+// assigned. Facts about A and D are only carried inside a basic block, so
+// every label resets them. Runs its rules until none of them applies.
+// Code is assumed to be addressed only through labels or through @n
+// directly followed by a jump; the latter are turned into labels first.
+// Generated names are owned here, so keep the optimizer alive until the
+// stream has been encoded.
+class PeepholeOptimizer {
+private:
+  vector<Instruction>& asms;
+  deque<string> names;
+
+  static bool isNumber(string_view s) {
+      return !s.empty() && isDigitChar(s[0]);
+  }
+
+  bool isNumericJump(size_t i) const {
+      return asms[i].type == I_A && isNumber(asms[i].addr) && i + 1 < asms.size()
+          && asms[i + 1].type == I_C && !asms[i + 1].jump.empty();
+  }
+
+  // @n / jump addresses ROM word n directly; label it so that code can
+  // move underneath. n past the program has no word to label and stays
+  void relocateNumericJumps() {
+      size_t size = 0;
+      for (const Instruction& ins : asms) {
+          size += ins.type != I_LABEL;
+      }
+      unordered_map<size_t, string_view> targets;
+      for (size_t i = 0; i < asms.size(); i++) {
+          if (isNumericJump(i)) {
+              size_t address = SymbolTable::literal(asms[i].addr);
+              if (address < size && !targets.contains(address)) {
+                  names.push_back("ROM$" + to_string(address));
+                  targets[address] = names.back();
+              }
+          }
+      }
+      if (targets.empty()) {
+          return;
+      }
+
+      vector<Instruction> out;
+      size_t address = 0;
+      for (size_t i = 0; i < asms.size(); i++) {
+          if (asms[i].type != I_LABEL) {
+              auto it = targets.find(address++);
+              if (it != targets.end()) {
+                  out.push_back(Instruction::label(it->second));
+              }
+          }
+          out.push_back(asms[i]);
+          if (isNumericJump(i)) {
+              auto target = targets.find(SymbolTable::literal(asms[i].addr));
+              if (target != targets.end()) {
+                  out.back().addr = target->second;
+              }
+          }
+      }
+      asms.swap(out);
+  }
+
+  static bool has(string_view field, char reg) {
+      return field.find(reg) != string_view::npos;
+  }
+
+  static bool isUnconditional(const Instruction& ins) {
+      return ins.type == I_C && ins.jump == "JMP";
+  }
+
+  // a jump whose target is only decided by the A register
+  static bool isPlainJump(const Instruction& ins) {
+      return ins.type == I_C && !ins.jump.empty() && ins.dest.empty()
+          && !has(ins.comp, 'A') && !has(ins.comp, 'M');
+  }
+
+  // code after an unconditional jump is unreachable up to the next label
+  bool removeDeadCode() {
+      vector<Instruction> out;
+      bool dead = false;
+      for (const Instruction& ins : asms) {
+          if (ins.type == I_LABEL) {
+              dead = false;
+          }
+          if (!dead) {
+              out.push_back(ins);
+          }
+          if (isUnconditional(ins)) {
+              dead = true;
+          }
+      }
+      bool changed = out.size() != asms.size();
+      asms.swap(out);
+      return changed;
+  }
+
+  // @L / jump, where L starts with @M / 0;JMP, becomes @M / jump
+  bool threadJumps() {
+      unordered_map<string_view, size_t> targets;
+      for (size_t i = 0; i < asms.size(); i++) {
+          if (asms[i].type == I_LABEL) {
+              size_t j = i;
+              while (j < asms.size() && asms[j].type == I_LABEL) {
+                  j++;
+              }
+              targets[asms[i].addr] = j;
+          }
+      }
+
+      bool changed = false;
+      for (size_t i = 0; i + 1 < asms.size(); i++) {
+          if (asms[i].type != I_A || !isPlainJump(asms[i + 1])) {
+              continue;
+          }
+          // a conditional jump falls through with A still loaded, so only
+          // retarget when the next instruction reloads A
+          if (!isUnconditional(asms[i + 1])
+              && (i + 2 >= asms.size() || asms[i + 2].type != I_A)) {
+              continue;
+          }
+
+          string_view target = asms[i].addr;
+          for (int hops = 0; hops < 16; hops++) {
+              auto it = targets.find(target);
+              if (it == targets.end() || it->second + 1 >= asms.size()) {
+                  break;
+              }
+              const Instruction& load = asms[it->second];
+              const Instruction& jump = asms[it->second + 1];
+              if (load.type != I_A || !isPlainJump(jump) || !isUnconditional(jump)
+                  || load.addr == target) {
+                  break;
+              }
+              target = load.addr;
+          }
+
+          if (target != asms[i].addr) {
+              asms[i].addr = target;
+              changed = true;
+          }
+      }
+      return changed;
+  }
+
+  // drops @X when A already holds X and D=M when D already holds M[X]
+  bool removeRedundantLoads() {
+      vector<Instruction> out;
+      string_view a; // symbol A was loaded with, empty when unknown
+      string_view d; // symbol whose RAM word D holds, empty when unknown
+
+      for (const Instruction& ins : asms) {
+          if (ins.type == I_LABEL) {
+              a = d = string_view();
+              out.push_back(ins);
+              continue;
+          }
+
+          if (ins.type == I_A) {
+              if (!a.empty() && a == ins.addr) {
+                  continue;
+              }
+              a = ins.addr;
+              out.push_back(ins);
+              continue;
+          }
+
+          bool writesA = has(ins.dest, 'A');
+          bool writesD = has(ins.dest, 'D');
+          bool writesM = has(ins.dest, 'M');
+          if (ins.dest == "D" && ins.comp == "M" && ins.jump.empty() && !a.empty() && d == a) {
+              continue;
+          }
+
+          if (writesD) {
+              // D=M and MD=... leave D equal to the word at A
+              bool fromM = (ins.dest == "D" && ins.comp == "M") || (writesM && !writesA);
+              d = fromM ? a : string_view();
+          } else if (writesM) {
+              // M=D keeps D equal to M, any other store may alias d
+              d = ins.comp == "D" && !writesA ? a : string_view();
+          }
+          if (writesA) {
+              a = string_view();
+          }
+          out.push_back(ins);
+      }
+
+      bool changed = out.size() != asms.size();
+      asms.swap(out);
+      return changed;
+  }
+
+  // M=M-1 / AM=M+1 leaves M as it was with A=M, M=M-1 / M=M+1 is a no-op
+  bool foldStackAdjust() {
+      vector<Instruction> out;
+      bool changed = false;
+      for (size_t i = 0; i < asms.size(); i++) {
+          const Instruction& ins = asms[i];
+          if (i + 1 < asms.size() && ins.type == I_C && asms[i + 1].type == I_C
+              && ins.dest == "M" && ins.jump.empty() && asms[i + 1].jump.empty()
+              && (ins.comp == "M-1" || ins.comp == "M+1")) {
+              const Instruction& next = asms[i + 1];
+              string_view undo = ins.comp == "M-1" ? "M+1" : "M-1";
+              if (next.comp == undo && (next.dest == "AM" || next.dest == "M")) {
+                  if (next.dest == "AM") {
+                      out.push_back(Instruction("A", "M", ""));
+                  }
+                  i++;
+                  changed = true;
+                  continue;
+              }
+          }
+          out.push_back(ins);
+      }
+      asms.swap(out);
+      return changed;
+  }
+
+  size_t instructionCount() const {
+      size_t n = 0;
+      for (const Instruction& ins : asms) {
+          n += ins.type != I_LABEL;
+      }
+      return n;
+  }
+
+public:
+    PeepholeOptimizer(vector<Instruction>& asms): asms(asms) {}
+
+    // number of instructions removed
+    size_t run() {
+        size_t before = instructionCount();
+        relocateNumericJumps();
+        bool changed = true;
+        while (changed) {
+            changed = removeDeadCode();
+            changed |= threadJumps();
+            changed |= removeRedundantLoads();
+            changed |= foldStackAdjust();
+        }
+        return before - instructionCount();
+    }
+};
@@ -0,0 +1,164 @@
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+// Arena
+// owns the bytes of every interned name so the table can key on string_view
+class Arena {
+private:
+  static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+  vector<unique_ptr<char[]>> blocks;
+  char* current = nullptr;
+  size_t used = BLOCK_SIZE;
+
+public:
+    string_view copy(string_view s) {
+        if (s.size() > BLOCK_SIZE / 4) {
+            // oversized names get a block of their own
+            blocks.emplace_back(new char[s.size()]);
+            memcpy(blocks.back().get(), s.data(), s.size());
+            return string_view(blocks.back().get(), s.size());
+        }
+
+        if (used + s.size() > BLOCK_SIZE) {
+            blocks.emplace_back(new char[BLOCK_SIZE]);
+            current = blocks.back().get();
+            used = 0;
+        }
+        char* p = current + used;
+        memcpy(p, s.data(), s.size());
+        used += s.size();
+        return string_view(p, s.size());
+    }
+};
+
+// SymbolTable
+// Open addressing over symbol ids. Every name is interned once and gets a
+// dense id; lookups hash the name a single time and walk one probe chain.
+class SymbolTable {
+private:
+  struct Symbol {
+      string_view name;
+      uint32_t hash;
+      uint16_t value;
+      bool defined;
+  };
+
+  static constexpr uint32_t EMPTY = 0xFFFFFFFF;
+
+  Arena arena;
+  vector<Symbol> symbols;
+  vector<uint32_t> slots; // symbol id per slot, power-of-two sized
+  uint16_t freeCounter = 16;
+
+  static uint32_t hashOf(string_view s) {
+      // FNV-1a
+      uint32_t h = 2166136261u;
+      for (char c : s) {
+          h = (h ^ uint8_t(c)) * 16777619u;
+      }
+      return h;
+  }
+
+  void grow() {
+      vector<uint32_t> old(slots.size() * 2, EMPTY);
+      slots.swap(old);
+      size_t mask = slots.size() - 1;
+      for (uint32_t id = 0; id < symbols.size(); id++) {
+          size_t i = symbols[id].hash & mask;
+          while (slots[i] != EMPTY) {
+              i = (i + 1) & mask;
+          }
+          slots[i] = id;
+      }
+  }
+
+public:
+    SymbolTable(): slots(64, EMPTY) {
+        static const pair<const char*, uint16_t> predefined[] = {
+            {"R0", 0},   {"R1", 1},   {"R2", 2},   {"R3", 3},
+            {"R4", 4},   {"R5", 5},   {"R6", 6},   {"R7", 7},
+            {"R8", 8},   {"R9", 9},   {"R10", 10}, {"R11", 11},
+            {"R12", 12}, {"R13", 13}, {"R14", 14}, {"R15", 15},
+            {"SCREEN", 16384},
+            {"KBD",    24576},
+            {"SP",     0},
+            {"LCL",    1},
+            {"ARG",    2},
+            {"THIS",   3},
+            {"THAT",   4}
+        };
+        for (const auto& [name, value] : predefined) {
+            put(name, value);
+        }
+    }
+
+    bool isSymbol(string_view s) const {
+        return (!s.empty() && isalpha(s[0]));
+    }
+
+    // id of the symbol, adding it undefined on first sight
+    uint32_t intern(string_view name) {
+        uint32_t h = hashOf(name);
+        size_t mask = slots.size() - 1;
+        size_t i = h & mask;
+        while (slots[i] != EMPTY) {
+            const Symbol& s = symbols[slots[i]];
+            if (s.hash == h && s.name == name) {
+                return slots[i];
+            }
+            i = (i + 1) & mask;
+        }
+
+        uint32_t id = symbols.size();
+        symbols.push_back({arena.copy(name), h, 0, false});
+        slots[i] = id;
+        if (symbols.size() * 2 > slots.size()) {
+            grow();
+        }
+        return id;
+    }
+
+    void put(string_view symbol, uint16_t value) {
+        define(intern(symbol), value);
+    }
+
+    void define(uint32_t id, uint16_t value) {
+        symbols[id].value = value;
+        symbols[id].defined = true;
+    }
+
+    bool isDefined(uint32_t id) const {
+        return symbols[id].defined;
+    }
+
+    uint16_t valueOf(uint32_t id) const {
+        return symbols[id].value;
+    }
+
+    uint16_t malloc(uint32_t id) {
+        define(id, freeCounter);
+        return freeCounter++;
+    }
+
+    static uint16_t literal(string_view s) {
+        int value = 0;
+        from_chars(s.data(), s.data() + s.size(), value);
+        return value;
+    }
+
+    uint16_t getOrMalloc(string_view symbol) {
+        if (isSymbol(symbol)) {
+            uint32_t id = intern(symbol);
+            return isDefined(id) ? valueOf(id) : malloc(id);
+        } else {
+            // return as literal
+            return literal(symbol);
+        }
+    }
+};
@@ -2,265 +2,281 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <exception>
+#include <thread>
 #include <stdexcept>
-#include <unordered_map>
-#include <bitset>
+#include "./Lexer.cc"
+#include "./Code.cc"
+#include "./SymbolTable.cc"
+#include "./Instruction.cc"
+#include "./Optimizer.cc"
 using namespace std;
 
-// static
-bool isHackCharSet(char c) {
-    return isalpha(c)
-      || isdigit(c)
-      || c == '+'
-      || c == '-'
-      || c == ';'
-      || c == '='
-      || c == '@'
-      || c == '.'
-      || c == '$'
-      || c == '_'
-      || c == '!'
-      || c == '&'
-      || c == '|'
-      ;
-}
-
-unordered_map<string, string> destCode = {
-      {"",    "000"},
-      {"M",   "001"},
-      {"D",   "010"},
-      {"MD",  "011"},
-      {"A",   "100"},
-      {"AM",  "101"},
-      {"AD",  "110"},
-      {"AMD", "111"}
-};
-
-unordered_map<string, string> jumpCode = {
-      {"",    "000"},
-      {"JGT", "001"},
-      {"JEQ", "010"},
-      {"JGE", "011"},
-      {"JLT", "100"},
-      {"JNE", "101"},
-      {"JLE", "110"},
-      {"JMP", "111"}
+// compact
+// Fixed-size record for the single-pass mode. A instructions that name a
+// symbol not yet defined keep its id and get their address at backpatch.
+struct PackedInstruction {
+    uint16_t word;
+    uint32_t symbol;
 };
 
-unordered_map<string, string> compCode = {
-      {"0",   "0101010"},
-      {"1",   "0111111"},
-      {"-1",  "0111010"},
-      {"D",   "0001100"},
-      {"A",   "0110000"},
-      {"M",   "1110000"},
-      {"!D",  "0001101"},
-      {"!A",  "0110001"},
-      {"!M",  "1110001"},
-      {"-D",  "0001111"},
-      {"-A",  "0110011"},
-      {"-M",  "1110011"},
-      {"D+1", "0011111"},
-      {"A+1", "0110111"},
-      {"M+1", "1110111"},
-      {"D-1", "0001110"},
-      {"A-1", "0110010"},
-      {"M-1", "1110010"},
-      {"D+A", "0000010"},
-      {"D+M", "1000010"},
-      {"D-A", "0010011"},
-      {"D-M", "1010011"},
-      {"A-D", "0000111"},
-      {"M-D", "1000111"},
-      {"D&A", "0000000"},
-      {"D&M", "1000000"},
-      {"D|A", "0010101"},
-      {"D|M", "1010101"}
-};
+constexpr uint32_t NO_SYMBOL = 0xFFFFFFFF;
 
-// class
-class SymbolTable {
-private:
-  unordered_map<string,string> table = {
-        {"R0",     "0"},
-        {"R1",     "1"},
-        {"R2",     "2"},
-        {"R3",     "3"},
-        {"R4",     "4"},
-        {"R5",     "5"},
-        {"R6",     "6"},
-        {"R7",     "7"},
-        {"R8",     "8"},
-        {"R9",     "9"},
-        {"R10",    "10"},
-        {"R11",    "11"},
-        {"R12",    "12"},
-        {"R13",    "13"},
-        {"R14",    "14"},
-        {"R15",    "15"},
-        {"SCREEN", "16384"},
-        {"KBD",    "24576"},
-        {"SP",     "0"},
-        {"LCL",    "1"},
-        {"ARG",    "2"},
-        {"THIS",   "3"},
-        {"THAT",   "4"}
-  };
+// two passes over a vector<Instruction>, optionally peephole optimized
+// in between
+vector<uint16_t> assemble(string_view source, SymbolTable& st, bool optimize) {
+    // Phase 1 Parsing
+    vector<Instruction> asms;
+    Lexer lexer(source);
+    for (Token t = lexer.next(); t.type != T_EOF; t = lexer.next()) {
+        if (t.type == T_LABEL) {
+            asms.push_back(Instruction::label(t.text));
+        } else if (t.type == T_A) {
+            asms.push_back(Instruction(t.text));
+        } else {
+            asms.push_back(Instruction::parse(t.text));
+        }
+    }
 
-  int freeCounter = 16;
+    PeepholeOptimizer optimizer(asms);
+    if (optimize) {
+        size_t removed = optimizer.run();
+        cerr << "peephole: removed " << removed << " instructions\n";
+    }
 
-public:
-  SymbolTable() {
-  }
+    size_t address = 0;
+    for (const Instruction& a: asms) {
+        if (a.isLabel()) {
+            st.put(a.labelName(), address);
+        } else {
+            address++;
+        }
+    }
 
-  bool isSymbol(const string& s) const {
-      return (!s.empty() && isalpha(s[0]));
-  }
+    // Phase 2
+    vector<uint16_t> words;
+    words.reserve(address);
+    for (const Instruction& a: asms) {
+        // cout << a << "\n";
+        if (!a.isLabel()) {
+            words.push_back(a.encode(st));
+        }
+    }
+    return words;
+}
 
-  void put(string symbol, string value) {
-      table[symbol] = value;
-  }
+// one pass over the source, forward references backpatched at the end
+vector<uint16_t> assembleCompact(string_view source, SymbolTable& st) {
+    vector<PackedInstruction> records;
+    Lexer lexer(source);
+    for (Token t = lexer.next(); t.type != T_EOF; t = lexer.next()) {
+        if (t.type == T_LABEL) {
+            st.put(t.text, records.size());
+        } else if (t.type == T_A) {
+            if (st.isSymbol(t.text)) {
+                uint32_t id = st.intern(t.text);
+                if (st.isDefined(id)) {
+                    records.push_back({st.valueOf(id), NO_SYMBOL});
+                } else {
+                    records.push_back({0, id});
+                }
+            } else {
+                records.push_back({uint16_t(SymbolTable::literal(t.text) & 0x7FFF), NO_SYMBOL});
+            }
+        } else {
+            records.push_back({Instruction::parse(t.text).encodeC(), NO_SYMBOL});
+        }
+    }
 
-  void malloc(string& symbol) {
-      put(symbol, to_string(freeCounter));
-      freeCounter += 1;
-  }
+    // backpatch in program order, which keeps variables allocated in
+    // order of first appearance
+    vector<uint16_t> words(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        const PackedInstruction& r = records[i];
+        if (r.symbol == NO_SYMBOL) {
+            words[i] = r.word;
+        } else if (st.isDefined(r.symbol)) {
+            words[i] = st.valueOf(r.symbol) & 0x7FFF;
+        } else {
+            words[i] = st.malloc(r.symbol) & 0x7FFF;
+        }
+    }
+    return words;
+}
 
-  string getOrMalloc(string symbol) {
-      if (isSymbol(symbol)) {
-          if (!table.contains(symbol)) {
-              malloc(symbol);
-          }
-          return table[symbol];
-      } else {
-          // return as literal
-          return symbol;
-      }
-  }
+// parallel
+// Chunks are split at line boundaries and lexed/encoded independently.
+// Symbol references are kept by name and resolved afterwards in chunk
+// order, so label addresses follow from a prefix sum of chunk sizes and
+// variables are allocated exactly as in the sequential passes.
+struct Chunk {
+    string_view source;
+    vector<uint16_t> words;
+    vector<pair<string_view, uint32_t>> labels; // name, local address
+    vector<pair<uint32_t, string_view>> refs;   // local index, symbol
+    exception_ptr error;
 };
 
-class Instruction {
-  bool isA; // is A instruction
-  string addr;
-  string dest;
-  string comp;
-  string jump;
+void assembleChunk(Chunk& chunk, const SymbolTable& st) {
+    try {
+        Lexer lexer(chunk.source);
+        for (Token t = lexer.next(); t.type != T_EOF; t = lexer.next()) {
+            if (t.type == T_LABEL) {
+                chunk.labels.push_back({t.text, chunk.words.size()});
+            } else if (t.type == T_A) {
+                if (st.isSymbol(t.text)) {
+                    chunk.refs.push_back({chunk.words.size(), t.text});
+                    chunk.words.push_back(0);
+                } else {
+                    chunk.words.push_back(SymbolTable::literal(t.text) & 0x7FFF);
+                }
+            } else {
+                chunk.words.push_back(Instruction::parse(t.text).encodeC());
+            }
+        }
+    } catch (...) {
+        chunk.error = current_exception();
+    }
+}
 
-  string IntTo15Bit(const string& integer) const {
-      return bitset<15>(atoi(integer.c_str())).to_string();
-  }
+vector<uint16_t> assembleParallel(string_view source, SymbolTable& st, int threads) {
+    vector<Chunk> chunks(threads);
+    size_t begin = 0;
+    for (int i = 0; i < threads; i++) {
+        size_t end = source.size() * (i + 1) / threads;
+        size_t eol = source.find('\n', max(begin, end));
+        end = (i == threads - 1 || eol == string_view::npos) ? source.size() : eol + 1;
+        chunks[i].source = source.substr(begin, end - begin);
+        begin = end;
+    }
 
-public:
-    Instruction(string addr): isA(true), addr(addr) {}
-    Instruction(string dest, string comp, string jump): isA(false), dest(dest), comp(comp), jump(jump) {}
+    vector<thread> workers;
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(assembleChunk, ref(chunks[i]), cref(st));
+    }
+    assembleChunk(chunks[0], st);
+    for (thread& w : workers) {
+        w.join();
+    }
 
-    string toByteString(SymbolTable& st) const {
-        if (isA) {
-            string res = st.getOrMalloc(addr);
-            // cout << "addr: " << addr << " res: " << res << "\n";
-            return "0" + IntTo15Bit(res);
-        } else {
-            return "111" + compCode[comp] + destCode[dest] + jumpCode[jump];
+    vector<size_t> base(threads + 1, 0);
+    for (int i = 0; i < threads; i++) {
+        if (chunks[i].error) {
+            rethrow_exception(chunks[i].error);
+        }
+        base[i + 1] = base[i] + chunks[i].words.size();
+        for (const auto& [name, address] : chunks[i].labels) {
+            st.put(name, base[i] + address);
         }
     }
 
-    static Instruction parse(ifstream& file) {
-        if (file.peek() == '@') {
-            // pase A instruction
-            file.get();
-            string addr = "";
-            while(isHackCharSet(file.peek())) {
-                char c = file.get();
-                addr += c;
-            }
-            return Instruction(addr);
-        } else {
-            vector<string> dcj= {"", "", ""}; // dest, comp, jump
-            int p = 1;
+    vector<uint16_t> words(base[threads]);
+    for (int i = 0; i < threads; i++) {
+        Chunk& chunk = chunks[i];
+        for (const auto& [index, name] : chunk.refs) {
+            chunk.words[index] = st.getOrMalloc(name) & 0x7FFF;
+        }
+        copy(chunk.words.begin(), chunk.words.end(), words.begin() + base[i]);
+    }
+    return words;
+}
 
-            while(isHackCharSet(file.peek())) {
-                char c = file.get();
-                if (c == '=') {
-                    dcj[0] = dcj[1];
-                    dcj[1] = "";
-                    continue;
-                }
-                if (c == ';') {
-                    p = 2;
-                    continue;
-                }
-                dcj[p] += c;
-            }
+// output
+// formatted through one fixed-size buffer, so output memory stays bounded
+constexpr size_t OUTPUT_CHUNK = 4096; // words per write
 
-            return Instruction(dcj[0], dcj[1], dcj[2]);
+// one "0101..." line per word
+void writeHack(ostream& out, const vector<uint16_t>& words) {
+    vector<char> buffer(OUTPUT_CHUNK * 17);
+    for (size_t begin = 0; begin < words.size(); begin += OUTPUT_CHUNK) {
+        size_t end = min(words.size(), begin + OUTPUT_CHUNK);
+        char* p = buffer.data();
+        for (size_t i = begin; i < end; i++) {
+            for (int bit = 15; bit >= 0; bit--) {
+                *p++ = '0' + ((words[i] >> bit) & 1);
+            }
+            *p++ = '\n';
         }
+        out.write(buffer.data(), p - buffer.data());
     }
+}
 
-    friend ostream& operator<<(ostream &os, const Instruction& ins) {
-        if (ins.isA) {
-            os << "@" + ins.addr;
-        } else {
-            os << ins.dest + "=" + ins.comp + ";" + ins.jump;
+// raw ROM image, one little-endian 16-bit word per instruction
+void writeRom(ostream& out, const vector<uint16_t>& words) {
+    vector<char> buffer(OUTPUT_CHUNK * 2);
+    for (size_t begin = 0; begin < words.size(); begin += OUTPUT_CHUNK) {
+        size_t end = min(words.size(), begin + OUTPUT_CHUNK);
+        char* p = buffer.data();
+        for (size_t i = begin; i < end; i++) {
+            *p++ = words[i] & 0xFF;
+            *p++ = words[i] >> 8;
         }
-        return os;
+        out.write(buffer.data(), p - buffer.data());
     }
-};
+}
 
 // main
 int main(int argc, char* argv[]) {
-    if (argc <= 1) {
-        cout << "./a.out <filename> ";
+    bool binary = false;
+    bool compact = false;
+    bool optimize = false;
+    int threads = 1;
+    string inputPath, outputPath;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "-b") {
+            binary = true;
+        } else if (arg == "-O") {
+            optimize = true;
+        } else if (arg == "-c") {
+            compact = true;
+        } else if (arg == "-j" && i + 1 < argc) {
+            threads = max(1, atoi(argv[++i]));
+        } else if (arg == "-o" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else {
+            inputPath = arg;
+        }
+    }
+
+    if (inputPath.empty()) {
+        cout << "./a.out [-b] [-O] [-c] [-j <threads>] [-o <output>] <filename>\n"
+             << "  -b  write a raw little-endian ROM image instead of .hack text\n"
+             << "  -O  peephole optimize the instruction stream (ignores -c and -j)\n"
+             << "  -c  single pass over compact records, less memory on large inputs\n"
+             << "  -j  lex and encode chunks of the input on that many threads\n";
         return 0;
     }
 
     // Symbol Table
     SymbolTable st = SymbolTable();
 
-    // Phase 1 Parsing
-    vector<Instruction> asms;
-    std::ifstream file(argv[1]);
-    // cout << "Parsing " << argv[1] << "\n";
+    MappedFile file(inputPath);
+    // cout << "Parsing " << inputPath << "\n";
     if (file.is_open()) {
-        string discard;
-        string line = "";
-        while(file) {
-          char c = file.peek();
-
-          // assuming no divid character
-          if (c == '/') {
-              getline(file, discard);
-              continue;
-          }
+        vector<uint16_t> words = optimize
+            ? assemble(file.view(), st, true)
+            : threads > 1
+            ? assembleParallel(file.view(), st, threads)
+            : compact
+            ? assembleCompact(file.view(), st)
+            : assemble(file.view(), st, false);
 
-          if (c == '(') {
-              file.get();
-              string symbol = "";
-              while(file.peek() != ')') {
-                  char sc = file.get();
-                  if (!isHackCharSet(sc)) {
-                      continue;
-                  }
-                  symbol += sc;
-              }
-
-              st.put(symbol, to_string(asms.size()));
-              continue;
-          }
-
-          if (!isHackCharSet(c)) {
-              file.get();
-              continue;
-          }
-
-          asms.push_back(Instruction::parse(file));
+        ofstream output;
+        if (!outputPath.empty()) {
+            output.open(outputPath, ios::binary);
+            if (!output.is_open()) {
+                cout << "Error Opening File " << outputPath;
+                return 1;
+            }
         }
-
-        for (const Instruction& a: asms) {
-            // cout << a << "\n";
-            cout << a.toByteString(st) << "\n";
+        ostream& out = outputPath.empty() ? cout : output;
+        if (binary) {
+            writeRom(out, words);
+        } else {
+            writeHack(out, words);
         }
-
-        // Phase 2
     } else {
         cout << "Error Opening File";
     }
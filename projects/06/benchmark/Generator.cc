@@ -0,0 +1,62 @@
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Generator
+// Synthetic Hack assembly with a configurable mix of A instructions
+// (literals, labels, variables), C instructions and label definitions.
+// Output is deterministic for a given seed.
+struct GeneratorConfig {
+    size_t lines = 100000;
+    double labels = 0.05;   // label definitions
+    double symbols = 0.15;  // @label references
+    double variables = 0.1; // @variable references
+    double literals = 0.1;  // @123
+    size_t variableCount = 2000;
+    unsigned seed = 1;
+    // the rest are C instructions
+};
+
+void generateAsm(ostream& out, const GeneratorConfig& config) {
+    static const vector<string> cInstructions = {
+        "D=M", "D=A", "M=D", "AM=M+1", "AM=M-1", "A=A-1", "M=M+D", "D=D-M",
+        "M=-1", "M=0", "D;JNE", "D;JGT", "0;JMP", "MD=M+1", "A=M", "D=D+A"
+    };
+
+    mt19937 rng(config.seed);
+    uniform_real_distribution<double> pick(0.0, 1.0);
+    size_t labelCount = max<size_t>(1, config.lines * config.labels);
+    uniform_int_distribution<size_t> anyLabel(0, labelCount - 1);
+    uniform_int_distribution<size_t> anyVariable(0, max<size_t>(1, config.variableCount) - 1);
+    uniform_int_distribution<int> anyLiteral(0, 32767);
+    uniform_int_distribution<size_t> anyC(0, cInstructions.size() - 1);
+
+    string buffer;
+    size_t nextLabel = 0;
+    for (size_t i = 0; i < config.lines; i++) {
+        double r = pick(rng);
+        if ((r -= config.labels) < 0 && nextLabel < labelCount) {
+            buffer += "(LABEL_" + to_string(nextLabel++) + ")\n";
+        } else if ((r -= config.symbols) < 0) {
+            buffer += "@LABEL_" + to_string(anyLabel(rng)) + "\n";
+        } else if ((r -= config.variables) < 0) {
+            buffer += "@var." + to_string(anyVariable(rng)) + "\n";
+        } else if ((r -= config.literals) < 0) {
+            buffer += "@" + to_string(anyLiteral(rng)) + "\n";
+        } else {
+            buffer += cInstructions[anyC(rng)] + "\n";
+        }
+
+        if (buffer.size() > 1 << 16) {
+            out << buffer;
+            buffer.clear();
+        }
+    }
+    // every referenced label gets defined
+    while (nextLabel < labelCount) {
+        buffer += "(LABEL_" + to_string(nextLabel++) + ")\n0;JMP\n";
+    }
+    out << buffer;
+}
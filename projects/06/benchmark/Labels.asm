@@ -0,0 +1,17 @@
+// Label definitions the lexer has to agree on with the stream parser,
+// run as: lexer_bench Labels.asm
+(LOOP)
+   @LOOP
+   0;JMP
+( SPACED )
+   @SPACED
+   0;JMP
+(	TABBED	)
+   @TABBED
+   D;JNE
+(TRAILING )
+   @TRAILING
+   0;JMP
+   ( INDENTED )   // comment after a label
+   @INDENTED
+   0;JMP
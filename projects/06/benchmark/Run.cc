@@ -0,0 +1,57 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+using namespace std;
+
+// Run
+// runs a command to completion with its output sent to /dev/null and reports
+// its wall time and peak resident set size
+struct RunResult {
+    double seconds;
+    long maxRssKb;
+    int status;
+};
+
+RunResult runCommand(const vector<string>& args) {
+    vector<char*> argv;
+    for (const string& a : args) {
+        argv.push_back(const_cast<char*>(a.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    auto begin = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw runtime_error("fork failed");
+    }
+    if (pid == 0) {
+        int fd = open("/dev/null", O_WRONLY);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+    return {elapsed.count(), usage.ru_maxrss, WIFEXITED(status) ? WEXITSTATUS(status) : -1};
+}
+
+// fastest of several runs, peak RSS of the largest
+RunResult bestRun(const vector<string>& args, int repeats) {
+    RunResult best = runCommand(args);
+    for (int i = 1; i < repeats; i++) {
+        RunResult r = runCommand(args);
+        best.seconds = min(best.seconds, r.seconds);
+        best.maxRssKb = max(best.maxRssKb, r.maxRssKb);
+        best.status = best.status ? best.status : r.status;
+    }
+    return best;
+}
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "./Generator.cc"
+#include "./Run.cc"
+using namespace std;
+
+// Times the assembler over real and synthetic inputs in each of its modes
+// and reports wall time, lines/sec and peak RSS per run. With --csv the
+// rows are also appended to a file so runs can be compared over time.
+
+size_t countLines(const string& path) {
+    ifstream file(path, ios::binary);
+    return count(istreambuf_iterator<char>(file), istreambuf_iterator<char>(), '\n');
+}
+
+vector<string> splitWords(const string& s) {
+    vector<string> words;
+    istringstream in(s);
+    for (string w; in >> w; ) {
+        words.push_back(w);
+    }
+    return words;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc <= 1) {
+        cout << "./a.out <assembler> [--synthetic n,n,...] [--mode \"flags\"]...\n"
+             << "        [--repeats n] [--csv file] [file.asm...]\n"
+             << "  defaults: --synthetic 100000,1000000, modes \"\" -c -O \"-j <cores>\"\n";
+        return 0;
+    }
+
+    string assembler(argv[1]);
+    vector<size_t> sizes;
+    vector<string> modes, inputs;
+    string csvPath;
+    int repeats = 3;
+    for (int i = 2; i < argc; i++) {
+        string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "--synthetic" && hasValue) {
+            stringstream list(argv[++i]);
+            for (string n; getline(list, n, ','); ) {
+                sizes.push_back(stoul(n));
+            }
+        } else if (arg == "--mode" && hasValue) {
+            modes.push_back(argv[++i]);
+        } else if (arg == "--repeats" && hasValue) {
+            repeats = max(1, atoi(argv[++i]));
+        } else if (arg == "--csv" && hasValue) {
+            csvPath = argv[++i];
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {100000, 1000000};
+    }
+    if (modes.empty()) {
+        unsigned cores = max(2u, thread::hardware_concurrency());
+        modes = {"", "-c", "-O", "-j " + to_string(cores)};
+    }
+
+    vector<string> generated;
+    for (size_t n : sizes) {
+        string path = "/tmp/assembler_bench." + to_string(getpid()) + "." + to_string(n) + ".asm";
+        GeneratorConfig config;
+        config.lines = n;
+        ofstream out(path);
+        generateAsm(out, config);
+        generated.push_back(path);
+        inputs.push_back(path);
+    }
+
+    ofstream csv;
+    if (!csvPath.empty()) {
+        csv.open(csvPath, ios::app);
+    }
+
+    cout << left << setw(44) << "input" << setw(8) << "mode" << right
+         << setw(10) << "lines" << setw(12) << "seconds"
+         << setw(14) << "lines/sec" << setw(12) << "maxRSS KB" << "\n";
+    int failures = 0;
+    for (const string& input : inputs) {
+        size_t lines = countLines(input);
+        for (const string& mode : modes) {
+            vector<string> args = {assembler};
+            for (const string& flag : splitWords(mode)) {
+                args.push_back(flag);
+            }
+            args.insert(args.end(), {"-o", "/dev/null", input});
+
+            RunResult r = bestRun(args, repeats);
+            failures += r.status != 0;
+            string name = input.size() > 42 ? "..." + input.substr(input.size() - 39) : input;
+            cout << left << setw(44) << name << setw(8) << (mode.empty() ? "-" : mode) << right
+                 << setw(10) << lines << setw(12) << fixed << setprecision(4) << r.seconds
+                 << setw(14) << setprecision(0) << lines / r.seconds
+                 << setw(12) << r.maxRssKb << (r.status ? "  FAILED" : "") << "\n";
+            if (csv.is_open()) {
+                csv << input << "," << mode << "," << lines << "," << r.seconds << ","
+                    << lines / r.seconds << "," << r.maxRssKb << "," << r.status << "\n";
+            }
+        }
+    }
+
+    for (const string& path : generated) {
+        remove(path.c_str());
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <string>
+#include "./Generator.cc"
+using namespace std;
+
+int main(int argc, char* argv[]) {
+    GeneratorConfig config;
+    bool haveLines = false;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if (arg == "--labels" && hasValue) {
+            config.labels = stod(argv[++i]);
+        } else if (arg == "--symbols" && hasValue) {
+            config.symbols = stod(argv[++i]);
+        } else if (arg == "--variables" && hasValue) {
+            config.variables = stod(argv[++i]);
+        } else if (arg == "--literals" && hasValue) {
+            config.literals = stod(argv[++i]);
+        } else if (arg == "--variable-count" && hasValue) {
+            config.variableCount = stoul(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            config.seed = stoul(argv[++i]);
+        } else {
+            config.lines = stoul(arg);
+            haveLines = true;
+        }
+    }
+
+    if (!haveLines) {
+        cout << "./a.out <lines> [--labels f] [--symbols f] [--variables f] [--literals f]\n"
+             << "        [--variable-count n] [--seed n] > out.asm\n"
+             << "  fractions of lines; the remainder are C instructions\n";
+        return 0;
+    }
+    generateAsm(cout, config);
+}
@@ -0,0 +1,161 @@
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "../assembler/Lexer.cc"
+using namespace std;
+
+// Compares the whole-buffer Lexer against the original peek()/get() stream
+// parser of assembler.cc. Both sides split C instructions into dest/comp/jump
+// and must find the same labels, e.g. in Labels.asm.
+
+// legacy
+bool isHackCharSet(char c) {
+    return isalpha(c)
+      || isdigit(c)
+      || c == '+'
+      || c == '-'
+      || c == ';'
+      || c == '='
+      || c == '@'
+      || c == '.'
+      || c == '$'
+      || c == '_'
+      || c == '!'
+      || c == '&'
+      || c == '|'
+      ;
+}
+
+size_t legacyParse(const char* path, vector<string>& labels) {
+    size_t count = 0;
+    std::ifstream file(path);
+    string discard;
+    while(file) {
+        char c = file.peek();
+        if (c == '/') {
+            getline(file, discard);
+            continue;
+        }
+
+        if (c == '(') {
+            file.get();
+            string symbol = "";
+            while(file.peek() != ')') {
+                char sc = file.get();
+                if (!isHackCharSet(sc)) {
+                    continue;
+                }
+                symbol += sc;
+            }
+            labels.push_back(symbol);
+            count++;
+            continue;
+        }
+
+        if (!isHackCharSet(c)) {
+            file.get();
+            continue;
+        }
+
+        if (file.peek() == '@') {
+            file.get();
+            string addr = "";
+            while(isHackCharSet(file.peek())) {
+                addr += file.get();
+            }
+        } else {
+            vector<string> dcj= {"", "", ""};
+            int p = 1;
+            while(isHackCharSet(file.peek())) {
+                char c = file.get();
+                if (c == '=') {
+                    dcj[0] = dcj[1];
+                    dcj[1] = "";
+                    continue;
+                }
+                if (c == ';') {
+                    p = 2;
+                    continue;
+                }
+                dcj[p] += c;
+            }
+        }
+        count++;
+    }
+    return count;
+}
+
+size_t lexerParse(const char* path, vector<string>& labels) {
+    size_t count = 0;
+    MappedFile file(path);
+    Lexer lexer(file.view());
+    for (Token t = lexer.next(); t.type != T_EOF; t = lexer.next()) {
+        if (t.type == T_LABEL) {
+            labels.emplace_back(t.text);
+        }
+        if (t.type == T_C) {
+            string_view text = t.text, dest, jump;
+            size_t eq = text.find('=');
+            if (eq != string_view::npos) {
+                dest = text.substr(0, eq);
+                text.remove_prefix(eq + 1);
+            }
+            size_t semi = text.find(';');
+            if (semi != string_view::npos) {
+                jump = text.substr(semi + 1);
+                text = text.substr(0, semi);
+            }
+        }
+        count++;
+    }
+    return count;
+}
+
+template <typename F>
+double bestOf(int iterations, F&& run) {
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        auto begin = chrono::steady_clock::now();
+        run();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc <= 1) {
+        cout << "./a.out <filename.asm> [iterations]\n";
+        return 0;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : 10;
+
+    MappedFile file(argv[1]);
+    if (!file.is_open()) {
+        cout << "Error Opening File\n";
+        return 1;
+    }
+    size_t lines = count(file.view().begin(), file.view().end(), '\n');
+
+    size_t legacyTokens = 0, lexerTokens = 0;
+    vector<string> legacyLabels, lexerLabels;
+    double legacy = bestOf(iterations, [&] { legacyLabels.clear(); legacyTokens = legacyParse(argv[1], legacyLabels); });
+    double lexer = bestOf(iterations, [&] { lexerLabels.clear(); lexerTokens = lexerParse(argv[1], lexerLabels); });
+    if (legacyTokens != lexerTokens) {
+        cout << "token count mismatch: " << legacyTokens << " vs " << lexerTokens << "\n";
+        return 1;
+    }
+    auto [a, b] = mismatch(legacyLabels.begin(), legacyLabels.end(), lexerLabels.begin(), lexerLabels.end());
+    if (a != legacyLabels.end() || b != lexerLabels.end()) {
+        cout << "label mismatch: (" << (a != legacyLabels.end() ? *a : "") << ") vs ("
+             << (b != lexerLabels.end() ? *b : "") << ")\n";
+        return 1;
+    }
+
+    cout << argv[1] << ": " << lines << " lines, " << lexerTokens << " tokens\n";
+    cout << "stream: " << lines / legacy << " lines/sec\n";
+    cout << "lexer:  " << lines / lexer << " lines/sec (" << legacy / lexer << "x)\n";
+}
@@ -0,0 +1,124 @@
+#include <chrono>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include "../assembler/Lexer.cc"
+#include "../assembler/Code.cc"
+using namespace std;
+
+// Compares mnemonic lookup through the constexpr perfect-hash tables in
+// Code.cc against the runtime-hashed unordered_map tables they replaced.
+// The mnemonics come from the C instructions of the given .asm file.
+
+// legacy
+unordered_map<string, uint16_t> legacyComp = {
+      {"0",   0b0101010}, {"1",   0b0111111}, {"-1",  0b0111010},
+      {"D",   0b0001100}, {"A",   0b0110000}, {"M",   0b1110000},
+      {"!D",  0b0001101}, {"!A",  0b0110001}, {"!M",  0b1110001},
+      {"-D",  0b0001111}, {"-A",  0b0110011}, {"-M",  0b1110011},
+      {"D+1", 0b0011111}, {"A+1", 0b0110111}, {"M+1", 0b1110111},
+      {"D-1", 0b0001110}, {"A-1", 0b0110010}, {"M-1", 0b1110010},
+      {"D+A", 0b0000010}, {"D+M", 0b1000010}, {"D-A", 0b0010011},
+      {"D-M", 0b1010011}, {"A-D", 0b0000111}, {"M-D", 0b1000111},
+      {"D&A", 0b0000000}, {"D&M", 0b1000000}, {"D|A", 0b0010101},
+      {"D|M", 0b1010101}, {"M+D", 0b1000010}, {"A+D", 0b0000010},
+      {"M&D", 0b1000000}, {"A&D", 0b0000000}, {"M|D", 0b1010101},
+      {"A|D", 0b0010101}
+};
+
+unordered_map<string, uint16_t> legacyDest = {
+      {"",    0b000}, {"M",   0b001}, {"D",   0b010}, {"MD",  0b011},
+      {"A",   0b100}, {"AM",  0b101}, {"AD",  0b110}, {"AMD", 0b111}
+};
+
+unordered_map<string, uint16_t> legacyJump = {
+      {"",    0b000}, {"JGT", 0b001}, {"JEQ", 0b010}, {"JGE", 0b011},
+      {"JLT", 0b100}, {"JNE", 0b101}, {"JLE", 0b110}, {"JMP", 0b111}
+};
+
+struct Fields {
+    string_view dest, comp, jump;
+};
+
+template <typename F>
+double bestOf(int iterations, F&& run) {
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        auto begin = chrono::steady_clock::now();
+        run();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc <= 1) {
+        cout << "./a.out <filename.asm> [iterations]\n";
+        return 0;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : 20;
+
+    MappedFile file(argv[1]);
+    if (!file.is_open()) {
+        cout << "Error Opening File\n";
+        return 1;
+    }
+
+    vector<Fields> fields;
+    Lexer lexer(file.view());
+    for (Token t = lexer.next(); t.type != T_EOF; t = lexer.next()) {
+        if (t.type != T_C) {
+            continue;
+        }
+        Fields f;
+        string_view text = t.text;
+        size_t eq = text.find('=');
+        if (eq != string_view::npos) {
+            f.dest = text.substr(0, eq);
+            text.remove_prefix(eq + 1);
+        }
+        size_t semi = text.find(';');
+        if (semi != string_view::npos) {
+            f.jump = text.substr(semi + 1);
+            text = text.substr(0, semi);
+        }
+        f.comp = text;
+        fields.push_back(f);
+    }
+
+    size_t legacySum = 0;
+    double legacy = bestOf(iterations, [&] {
+        legacySum = 0;
+        for (const Fields& f : fields) {
+            legacySum += 0xE000
+                | legacyComp.find(string(f.comp))->second << 6
+                | legacyDest.find(string(f.dest))->second << 3
+                | legacyJump.find(string(f.jump))->second;
+        }
+    });
+
+    size_t hashSum = 0;
+    double hashed = bestOf(iterations, [&] {
+        hashSum = 0;
+        for (const Fields& f : fields) {
+            hashSum += 0xE000
+                | lookupCode(compCode, f.comp) << 6
+                | lookupCode(destCode, f.dest) << 3
+                | lookupCode(jumpCode, f.jump);
+        }
+    });
+
+    if (legacySum != hashSum) {
+        cout << "encoding mismatch\n";
+        return 1;
+    }
+
+    double n = fields.size();
+    cout << argv[1] << ": " << fields.size() << " C instructions\n";
+    cout << "unordered_map: " << legacy / n * 1e9 << " ns/instruction\n";
+    cout << "perfect hash:  " << hashed / n * 1e9 << " ns/instruction ("
+         << legacy / hashed << "x)\n";
+}
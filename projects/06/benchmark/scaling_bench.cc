@@ -0,0 +1,47 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include "./Run.cc"
+using namespace std;
+
+// Runs the assembler with -j 1..N on one input, checks that every thread
+// count produces the same output as -j 1 and prints wall time and speedup.
+
+string readFile(const string& path) {
+    ifstream file(path, ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+int main(int argc, char* argv[]) {
+    if (argc <= 2) {
+        cout << "./a.out <assembler> <filename.asm> [max threads] [repeats]\n";
+        return 0;
+    }
+    string assembler(argv[1]), input(argv[2]);
+    int maxThreads = argc > 3 ? atoi(argv[3]) : max(1u, thread::hardware_concurrency());
+    int repeats = argc > 4 ? atoi(argv[4]) : 5;
+
+    string reference;
+    double base = 0;
+    cout << "threads  seconds  speedup\n";
+    for (int j = 1; j <= maxThreads; j++) {
+        string out = "/tmp/scaling_bench." + to_string(getpid()) + ".hack";
+        RunResult r = bestRun({assembler, "-j", to_string(j), "-o", out, input}, repeats);
+        string output = readFile(out);
+        remove(out.c_str());
+        if (r.status != 0) {
+            cout << "assembler failed with -j " << j << "\n";
+            return 1;
+        }
+        if (j == 1) {
+            reference = output;
+            base = r.seconds;
+        } else if (output != reference) {
+            cout << "output with -j " << j << " differs from -j 1\n";
+            return 1;
+        }
+        cout << j << "        " << r.seconds << "  " << base / r.seconds << "\n";
+    }
+}
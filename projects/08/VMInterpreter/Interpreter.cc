@@ -0,0 +1,183 @@
+#include <array>
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+#include "./Program.cc"
+using namespace std;
+
+// Interpreter
+// Runs a Program on the Hack RAM: SP, LCL, ARG, THIS and THAT at 0-4,
+// temp at 5-12, statics from 16, the stack from 256, SCREEN at 16384 and
+// KBD at 24576. Frames are laid out as the translated code lays them out,
+// so a program leaves the same RAM behind, with the return address being
+// an instruction index. Every instruction jumps straight to the next
+// one's handler (direct threading, needs GCC or Clang labels as values).
+// Returning to an address past the program halts it, which the tests that
+// fake a caller's frame rely on.
+// Addresses wrap at 32K like the Hack CPU's A register.
+class Interpreter {
+private:
+  array<int16_t, 32768> ram{};
+  uint64_t steps = 0;
+  bool halted = false;
+
+public:
+    static constexpr int SP = 0;
+    static constexpr int LCL = 1;
+    static constexpr int ARG = 2;
+    static constexpr int THIS = 3;
+    static constexpr int THAT = 4;
+    static constexpr int SCREEN = 16384;
+    static constexpr int KBD = 24576;
+
+    int16_t& operator[](int address) {
+        return ram[address & 0x7FFF];
+    }
+
+    // commands executed by the last run
+    uint64_t stepCount() const {
+        return steps;
+    }
+
+    // false when the last run stopped at maxSteps
+    bool isHalted() const {
+        return halted;
+    }
+
+    // runs from the first instruction until the program halts or about
+    // maxSteps commands ran, checked at jumps, calls and returns. SP is
+    // kept in a register meanwhile and only stored to RAM[0] when done
+    void run(Program& program, uint64_t maxSteps = UINT64_MAX) {
+        // in Op order
+        static const void* const handlers[] = {
+            &&add, &&sub, &&neg, &&eq, &&gt, &&lt, &&and_, &&or_, &&not_,
+            &&pushConstant, &&pushDirect, &&pushIndirect, &&popDirect, &&popIndirect,
+            &&goto_, &&if_, &&function, &&call, &&return_, &&halt, &&undefined
+        };
+        static_assert(size(handlers) == I_UNDEFINED + 1);
+        for (Instruction& in : program.code) {
+            in.handler = handlers[in.op];
+        }
+
+        int16_t* m = ram.data();
+        auto at = [m](int address) -> int16_t& {
+            return m[address & 0x7FFF];
+        };
+        const Instruction* code = program.code.data();
+        const Instruction* ip = code;
+        int sp = m[SP];
+        uint64_t n = 0;
+        halted = false;
+
+#define NEXT n++; ip++; goto *ip->handler
+#define JUMP(target) n++; ip = code + (target); if (n >= maxSteps) goto stop; goto *ip->handler
+
+        goto *ip->handler;
+
+    add:
+        sp--;
+        at(sp - 1) = int16_t(at(sp - 1) + at(sp));
+        NEXT;
+    sub:
+        sp--;
+        at(sp - 1) = int16_t(at(sp - 1) - at(sp));
+        NEXT;
+    neg:
+        at(sp - 1) = int16_t(-at(sp - 1));
+        NEXT;
+    eq:
+        sp--;
+        at(sp - 1) = at(sp - 1) == at(sp) ? -1 : 0;
+        NEXT;
+    gt:
+        sp--;
+        at(sp - 1) = at(sp - 1) > at(sp) ? -1 : 0;
+        NEXT;
+    lt:
+        sp--;
+        at(sp - 1) = at(sp - 1) < at(sp) ? -1 : 0;
+        NEXT;
+    and_:
+        sp--;
+        at(sp - 1) &= at(sp);
+        NEXT;
+    or_:
+        sp--;
+        at(sp - 1) |= at(sp);
+        NEXT;
+    not_:
+        at(sp - 1) = ~at(sp - 1);
+        NEXT;
+
+    pushConstant:
+        at(sp++) = ip->a;
+        NEXT;
+    pushDirect:
+        at(sp++) = m[ip->a];
+        NEXT;
+    pushIndirect:
+        at(sp++) = at(m[ip->a] + ip->b);
+        NEXT;
+    popDirect:
+        m[ip->a] = at(--sp);
+        NEXT;
+    popIndirect:
+        sp--;
+        at(m[ip->a] + ip->b) = at(sp);
+        NEXT;
+
+    goto_:
+        JUMP(ip->b);
+    if_:
+        if (at(--sp) != 0) {
+            JUMP(ip->b);
+        }
+        NEXT;
+
+    function:
+        for (int i = 0; i < ip->a; i++) {
+            at(sp++) = 0;
+        }
+        NEXT;
+    call:
+        at(sp) = int16_t(ip - code + 1);
+        at(sp + 1) = m[LCL];
+        at(sp + 2) = m[ARG];
+        at(sp + 3) = m[THIS];
+        at(sp + 4) = m[THAT];
+        m[ARG] = int16_t(sp - ip->a);
+        sp += 5;
+        m[LCL] = int16_t(sp);
+        JUMP(ip->b);
+    return_: {
+        // the return value may overwrite the return address when nArgs is 0
+        int frame = m[LCL];
+        size_t returnAddress = uint16_t(at(frame - 5));
+        at(m[ARG]) = at(sp - 1);
+        sp = m[ARG] + 1;
+        m[THAT] = at(frame - 1);
+        m[THIS] = at(frame - 2);
+        m[ARG] = at(frame - 3);
+        m[LCL] = at(frame - 4);
+        // leaving the program halts, as on the Hack CPU
+        if (returnAddress >= program.code.size()) {
+            goto halt;
+        }
+        JUMP(returnAddress);
+    }
+
+    undefined:
+        m[SP] = int16_t(sp);
+        steps = n;
+        throw runtime_error("call to undefined function " + program.undefined[ip->a]);
+
+    halt:
+        halted = true;
+    stop:
+        m[SP] = int16_t(sp);
+        steps = n;
+
+#undef NEXT
+#undef JUMP
+    }
+};
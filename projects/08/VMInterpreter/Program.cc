@@ -0,0 +1,186 @@
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdexcept>
+#include "../VMTranslator/SourceReader.cc"
+using namespace std;
+
+// arithmetic ops come first, in Operator order
+enum Op : uint8_t {
+    I_ADD,
+    I_SUB,
+    I_NEG,
+    I_EQ,
+    I_GT,
+    I_LT,
+    I_AND,
+    I_OR,
+    I_NOT,
+
+    I_PUSH_CONSTANT,  // a = value
+    I_PUSH_DIRECT,    // a = address of a temp, pointer or static slot
+    I_PUSH_INDIRECT,  // a = address of LCL/ARG/THIS/THAT, b = index
+    I_POP_DIRECT,
+    I_POP_INDIRECT,
+    I_GOTO,           // b = target
+    I_IF,
+    I_FUNCTION,       // a = nVars
+    I_CALL,           // a = nArgs, b = target
+    I_RETURN,
+    I_HALT,           // a goto to itself, or past the last command
+    I_UNDEFINED       // call of a function no file defines, a = its name in undefined
+};
+
+static_assert(I_ADD == Op(OP_ADD) && I_NOT == Op(OP_NOT));
+
+// one VM command with its operands resolved; handler is the address of
+// the interpreter code for op, filled in once before running
+struct Instruction {
+    const void* handler = nullptr;
+    Op op;
+    int a = 0;
+    int b = 0;
+};
+
+// Program
+// The commands of all files as one instruction array. Labels and
+// functions become positions in it and static slots RAM addresses from
+// 16 on, handed out in order of first use like the assembler does.
+// Label commands take no instruction.
+struct Program {
+    vector<Instruction> code;
+    vector<string> undefined;
+    unordered_map<string, size_t> functions;  // undefined ones at their I_UNDEFINED
+    int statics = 0;
+};
+
+// bootstrap starts with "call Sys.init 0" as the translator does for a
+// directory; without it the program starts at its first command
+Program link(const vector<SourceFile>& files, bool bootstrap) {
+    Program program;
+    unordered_map<string, size_t> labels;
+    unordered_map<string, int> statics;
+    vector<pair<size_t, string>> jumps;  // goto, if-goto and call targets
+    auto emit = [&](Op op, int a = 0, int b = 0) {
+        program.code.push_back(Instruction{nullptr, op, a, b});
+    };
+
+    if (bootstrap) {
+        jumps.push_back({program.code.size(), "Sys.init"});
+        emit(I_CALL, 0);
+        emit(I_HALT);
+    }
+
+    for (const SourceFile& file : files) {
+        // VM labels are local to their function
+        string function;
+        auto scoped = [&](const string& label) {
+            return function.empty() ? label : function + "$" + label;
+        };
+        auto address = [&](const Command& c) {
+            switch (c.segment) {
+            case S_TEMP:
+                if (c.arg2 < 0 || c.arg2 > 7) {
+                    throw invalid_argument(file.name + ": temp " + to_string(c.arg2) + " is invalid.");
+                }
+                return 5 + c.arg2;
+            case S_POINTER:
+                if (c.arg2 < 0 || c.arg2 > 1) {
+                    throw invalid_argument(file.name + ": pointer " + to_string(c.arg2) + " is invalid.");
+                }
+                return 3 + c.arg2;
+            default: {
+                auto [it, added] = statics.try_emplace(file.name + "." + to_string(c.arg2), 16 + program.statics);
+                program.statics += added;
+                return it->second;
+            }
+            }
+        };
+        auto base = [](Segment segment) {
+            return segment == S_LOCAL ? 1 : segment == S_ARGUMENT ? 2 : segment == S_THIS ? 3 : 4;
+        };
+
+        for (const Command& c : file.commands) {
+            switch (c.type) {
+            case C_ARITHMETIC:
+                emit(Op(c.op));
+                break;
+            case C_PUSH:
+                if (c.segment == S_CONSTANT) {
+                    emit(I_PUSH_CONSTANT, c.arg2);
+                } else if (c.segment == S_TEMP || c.segment == S_POINTER || c.segment == S_STATIC) {
+                    emit(I_PUSH_DIRECT, address(c));
+                } else {
+                    emit(I_PUSH_INDIRECT, base(c.segment), c.arg2);
+                }
+                break;
+            case C_POP:
+                if (c.segment == S_CONSTANT) {
+                    throw invalid_argument(file.name + ": pop constant is invalid.");
+                } else if (c.segment == S_TEMP || c.segment == S_POINTER || c.segment == S_STATIC) {
+                    emit(I_POP_DIRECT, address(c));
+                } else {
+                    emit(I_POP_INDIRECT, base(c.segment), c.arg2);
+                }
+                break;
+            case C_LABEL:
+                labels[scoped(c.name)] = program.code.size();
+                break;
+            case C_GOTO:
+            case C_IF:
+                jumps.push_back({program.code.size(), scoped(c.name)});
+                emit(c.type == C_GOTO ? I_GOTO : I_IF);
+                break;
+            case C_FUNCTION:
+                function = c.name;
+                if (!program.functions.try_emplace(c.name, program.code.size()).second) {
+                    throw invalid_argument(file.name + ": function " + c.name + " is defined twice.");
+                }
+                emit(I_FUNCTION, c.arg2);
+                break;
+            case C_CALL:
+                jumps.push_back({program.code.size(), c.name});
+                emit(I_CALL, c.arg2);
+                break;
+            case C_RETURN:
+                emit(I_RETURN);
+                break;
+            default:
+                throw invalid_argument(file.name + ": unexpected command.");
+            }
+        }
+    }
+    emit(I_HALT);
+
+    for (size_t j = 0; j < jumps.size(); j++) {
+        auto [at, name] = jumps[j];
+        if (program.code[at].op == I_CALL) {
+            auto f = program.functions.find(name);
+            if (f == program.functions.end()) {
+                // fails only when it runs, e.g. a Jack program without the OS
+                f = program.functions.emplace(name, program.code.size()).first;
+                emit(I_UNDEFINED, program.undefined.size());
+                program.undefined.push_back(name);
+            }
+            program.code[at].b = f->second;
+            continue;
+        }
+        auto label = labels.find(name);
+        if (label == labels.end()) {
+            throw invalid_argument("label: " + name + " is not defined.");
+        }
+        Instruction& in = program.code[at];
+        in.b = label->second;
+        // label L / goto L
+        if (in.op == I_GOTO && size_t(in.b) == at) {
+            in.op = I_HALT;
+        }
+    }
+
+    // return addresses are stored in RAM words
+    if (program.code.size() > 65536) {
+        throw invalid_argument("program: " + to_string(program.code.size()) + " commands, at most 65536 fit.");
+    }
+    return program;
+}
@@ -0,0 +1,100 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "./Interpreter.cc"
+using namespace std;
+
+// the screen as a 512x256 plain PBM image, a set bit is a black pixel
+void writeScreen(Interpreter& vm, const string& path) {
+    ofstream out(path);
+    if (!out.is_open()) {
+        throw invalid_argument("cannot write " + path);
+    }
+    out << "P1\n512 256\n";
+    for (int row = 0; row < 256; row++) {
+        for (int col = 0; col < 512; col++) {
+            out << ((vm[Interpreter::SCREEN + row * 32 + col / 16] >> (col % 16)) & 1);
+            out << (col % 64 == 63 ? '\n' : ' ');
+        }
+    }
+}
+
+// main
+int main(int argc, char* argv[]) {
+    string path, screenPath;
+    vector<pair<int, int>> setup;
+    vector<int> outputs;
+    uint64_t maxSteps = UINT64_MAX;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "--set" && i + 1 < argc) {
+            string cell(argv[++i]);
+            size_t eq = cell.find('=');
+            if (eq == string::npos) {
+                cerr << "--set expects <address>=<value>\n";
+                return 1;
+            }
+            setup.push_back({stoi(cell.substr(0, eq)), stoi(cell.substr(eq + 1))});
+        } else if (arg == "--print" && i + 1 < argc) {
+            string cells(argv[++i]);
+            for (size_t start = 0; start <= cells.size(); ) {
+                size_t comma = min(cells.find(',', start), cells.size());
+                outputs.push_back(stoi(cells.substr(start, comma - start)));
+                start = comma + 1;
+            }
+        } else if (arg == "--steps" && i + 1 < argc) {
+            maxSteps = stoull(argv[++i]);
+        } else if (arg == "--screen" && i + 1 < argc) {
+            screenPath = argv[++i];
+        } else {
+            path = arg;
+        }
+    }
+
+    if (path.empty()) {
+        cout << "./a.out [options] <filename.vm | filename.vmb>\n"
+             << "./a.out [options] <directory>   starts with call Sys.init 0, SP=256\n"
+             << "  --set <a>=<v>        RAM[a] = v before running, e.g. --set 0=256\n"
+             << "  --print <a>[,<b>..]  print RAM[a], RAM[b]... when done\n"
+             << "  --steps <n>          stop after about n commands instead of at the end\n"
+             << "  --screen <file.pbm>  write the screen as an image when done\n";
+        return 0;
+    }
+
+    try {
+        error_code ec;
+        bool directory = filesystem::is_directory(path, ec);
+        vector<SourceFile> sources = directory ? readDirectory(path) : vector<SourceFile>{readSourceFile(path)};
+        Program program = link(sources, directory);
+
+        Interpreter vm;
+        for (auto [address, value] : setup) {
+            vm[address] = value;
+        }
+        // as the translated bootstrap does
+        if (directory) {
+            vm[Interpreter::SP] = 256;
+        }
+
+        auto begin = chrono::steady_clock::now();
+        vm.run(program, maxSteps);
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+
+        for (int address : outputs) {
+            cout << "RAM[" << address << "] = " << vm[address] << "\n";
+        }
+        if (!screenPath.empty()) {
+            writeScreen(vm, screenPath);
+        }
+        cerr << (vm.isHalted() ? "halted" : "stopped") << " after " << vm.stepCount() << " commands in "
+             << elapsed.count() * 1000 << " ms ("
+             << (elapsed.count() > 0 ? vm.stepCount() / elapsed.count() / 1e6 : 0) << " M commands/s)\n";
+    } catch (const exception& e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,210 @@
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// .vmb
+// Binary form of a .vm file, shared by the Jack compiler (writer) and the
+// VM translator (reader). Little-endian, laid out as
+//
+//   VmbHeader                      20 bytes
+//   VmbInstruction[instructions]    8 bytes each
+//   uint32_t[strings + 1]           string offsets into the bytes below
+//   char[stringBytes]               label and function names, no separators
+//
+// Opcodes and segment ids are positions in vmbOpcodeNames and
+// vmbSegmentNames. Only label, goto, if-goto, function and call use the
+// name field, an index into the string table.
+static_assert(endian::native == endian::little, ".vmb is read in place on little-endian hosts");
+
+constexpr char VMB_MAGIC[4] = {'H', 'V', 'M', 'B'};
+constexpr uint32_t VMB_VERSION = 1;
+
+enum VmbOpcode : uint8_t {
+    VMB_ADD, VMB_SUB, VMB_NEG, VMB_EQ, VMB_GT, VMB_LT, VMB_AND, VMB_OR, VMB_NOT,
+    VMB_PUSH, VMB_POP, VMB_LABEL, VMB_GOTO, VMB_IF, VMB_FUNCTION, VMB_CALL, VMB_RETURN,
+    VMB_OPCODES
+};
+
+constexpr string_view vmbOpcodeNames[VMB_OPCODES] = {
+    "add", "sub", "neg", "eq", "gt", "lt", "and", "or", "not",
+    "push", "pop", "label", "goto", "if-goto", "function", "call", "return"
+};
+
+constexpr string_view vmbSegmentNames[] = {
+    "constant", "local", "argument", "this", "that", "temp", "static", "pointer"
+};
+constexpr size_t VMB_SEGMENTS = size(vmbSegmentNames);
+
+struct VmbHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t instructions;
+    uint32_t strings;
+    uint32_t stringBytes;
+};
+
+struct VmbInstruction {
+    uint8_t opcode;
+    uint8_t segment;  // push/pop
+    uint16_t index;   // push/pop index, function nVars, call nArgs
+    uint32_t name;    // string id
+};
+
+static_assert(sizeof(VmbHeader) == 20 && sizeof(VmbInstruction) == 8);
+
+// position of a VM word in one of the name tables above, -1 when unknown
+template <size_t N>
+int findVmbName(const string_view (&names)[N], string_view word) {
+    for (size_t i = 0; i < N; i++) {
+        if (names[i] == word) return i;
+    }
+    return -1;
+}
+
+// BytecodeWriter
+// collects one file's instructions, names interned as they come
+class BytecodeWriter {
+private:
+  vector<VmbInstruction> code;
+  vector<string> strings;
+  unordered_map<string, uint32_t> ids;
+  size_t stringBytes = 0;
+
+  uint32_t intern(string_view name) {
+      auto [it, added] = ids.try_emplace(string(name), strings.size());
+      if (added) {
+          strings.emplace_back(name);
+          stringBytes += name.size();
+      }
+      return it->second;
+  }
+
+  template <typename T>
+  static void append(string& out, const T& value) {
+      out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+public:
+    void add(uint8_t opcode, uint8_t segment = 0, int index = 0, string_view name = {}) {
+        if (opcode >= VMB_OPCODES || segment >= VMB_SEGMENTS) {
+            throw invalid_argument("vmb: bad opcode or segment");
+        }
+        if (index < 0 || index > 0xFFFF) {
+            throw invalid_argument("vmb: index out of range: " + to_string(index));
+        }
+        uint32_t id = name.empty() ? 0 : intern(name);
+        code.push_back({opcode, segment, uint16_t(index), id});
+    }
+
+    // the same command in VM spelling, e.g. ("push", "local", 2)
+    void add(string_view opcode, string_view segment, int index, string_view name = {}) {
+        int op = findVmbName(vmbOpcodeNames, opcode);
+        int seg = segment.empty() ? 0 : findVmbName(vmbSegmentNames, segment);
+        if (op < 0 || seg < 0) {
+            throw invalid_argument("vmb: unknown command: " + string(opcode) + " " + string(segment));
+        }
+        add(op, seg, index, name);
+    }
+
+    size_t size() const {
+        return code.size();
+    }
+
+    string bytes() const {
+        string out;
+        out.reserve(sizeof(VmbHeader) + code.size() * sizeof(VmbInstruction)
+                    + (strings.size() + 1) * sizeof(uint32_t) + stringBytes);
+        VmbHeader header{};
+        memcpy(header.magic, VMB_MAGIC, sizeof(VMB_MAGIC));
+        header.version = VMB_VERSION;
+        header.instructions = code.size();
+        header.strings = strings.size();
+        header.stringBytes = stringBytes;
+        append(out, header);
+        for (const VmbInstruction& i : code) {
+            append(out, i);
+        }
+        uint32_t offset = 0;
+        for (const string& s : strings) {
+            append(out, offset);
+            offset += s.size();
+        }
+        append(out, offset);
+        for (const string& s : strings) {
+            out.append(s);
+        }
+        return out;
+    }
+};
+
+// BytecodeReader
+// views a whole .vmb image, e.g. a mapped file. The layout is checked once
+// here so that reading instructions and names needs no further checks
+// beyond the ids.
+class BytecodeReader {
+private:
+  string_view data;
+  VmbHeader header;
+  const char* code;
+  const char* offsets;
+  const char* names;
+
+  uint32_t offset(uint32_t i) const {
+      uint32_t value;
+      memcpy(&value, offsets + i * sizeof(uint32_t), sizeof(value));
+      return value;
+  }
+
+public:
+    BytecodeReader(string_view data): data(data) {
+        if (data.size() < sizeof(VmbHeader)) {
+            throw invalid_argument("vmb: truncated header");
+        }
+        memcpy(&header, data.data(), sizeof(header));
+        if (memcmp(header.magic, VMB_MAGIC, sizeof(VMB_MAGIC)) != 0) {
+            throw invalid_argument("vmb: not a .vmb file");
+        }
+        if (header.version != VMB_VERSION) {
+            throw invalid_argument("vmb: unsupported version " + to_string(header.version));
+        }
+        uint64_t size = sizeof(VmbHeader) + uint64_t(header.instructions) * sizeof(VmbInstruction)
+            + (uint64_t(header.strings) + 1) * sizeof(uint32_t) + header.stringBytes;
+        if (size != data.size()) {
+            throw invalid_argument("vmb: size does not match the header");
+        }
+        code = data.data() + sizeof(VmbHeader);
+        offsets = code + header.instructions * sizeof(VmbInstruction);
+        names = offsets + (header.strings + 1) * sizeof(uint32_t);
+        for (uint32_t i = 0; i < header.strings; i++) {
+            if (offset(i) > offset(i + 1)) {
+                throw invalid_argument("vmb: bad string table");
+            }
+        }
+        if (offset(header.strings) != header.stringBytes) {
+            throw invalid_argument("vmb: bad string table");
+        }
+    }
+
+    size_t size() const {
+        return header.instructions;
+    }
+
+    VmbInstruction at(size_t i) const {
+        VmbInstruction instruction;
+        memcpy(&instruction, code + i * sizeof(VmbInstruction), sizeof(instruction));
+        return instruction;
+    }
+
+    string_view name(uint32_t id) const {
+        if (id >= header.strings) {
+            throw invalid_argument("vmb: bad string id " + to_string(id));
+        }
+        return string_view(names + offset(id), offset(id + 1) - offset(id));
+    }
+};
@@ -0,0 +1,103 @@
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+using namespace std;
+
+// one function's commands inside a SourceFile, [begin, end)
+struct FunctionInfo {
+    size_t file;
+    size_t begin;
+    size_t end;
+    vector<string> callees; // in call order, repeats included
+};
+
+// CallGraph
+// Functions of the whole program keyed by name, with an edge per call
+// command. Commands before a file's first function belong to no function.
+class CallGraph {
+private:
+  unordered_map<string, FunctionInfo> functions;
+
+public:
+    CallGraph(const vector<SourceFile>& files) {
+        for (size_t f = 0; f < files.size(); f++) {
+            const vector<Command>& commands = files[f].commands;
+            FunctionInfo* current = nullptr;
+            for (size_t i = 0; i < commands.size(); i++) {
+                const Command& c = commands[i];
+                if (c.type == C_FUNCTION) {
+                    if (current) {
+                        current->end = i;
+                    }
+                    current = &functions[c.name];
+                    *current = FunctionInfo{};
+                    current->file = f;
+                    current->begin = i;
+                    current->end = commands.size();
+                } else if (c.type == C_CALL && current) {
+                    current->callees.push_back(c.name);
+                }
+            }
+        }
+    }
+
+    bool contains(const string& name) const {
+        return functions.contains(name);
+    }
+
+    const FunctionInfo& at(const string& name) const {
+        return functions.at(name);
+    }
+
+    size_t size() const {
+        return functions.size();
+    }
+
+    // names of the functions reachable from root, root included
+    unordered_set<string> reachableFrom(const string& root) const {
+        unordered_set<string> seen;
+        vector<string> work;
+        if (contains(root)) {
+            seen.insert(root);
+            work.push_back(root);
+        }
+        while (!work.empty()) {
+            string name = work.back();
+            work.pop_back();
+            for (const string& callee : at(name).callees) {
+                if (contains(callee) && seen.insert(callee).second) {
+                    work.push_back(callee);
+                }
+            }
+        }
+        return seen;
+    }
+};
+
+// drops every function that can't be reached from root; returns the
+// number of functions removed, 0 when root is missing
+size_t removeDeadFunctions(vector<SourceFile>& files, const string& root) {
+    CallGraph graph(files);
+    if (!graph.contains(root)) {
+        return 0;
+    }
+    unordered_set<string> live = graph.reachableFrom(root);
+
+    size_t removed = 0;
+    for (SourceFile& file : files) {
+        vector<Command> kept;
+        bool dead = false;
+        for (Command& c : file.commands) {
+            if (c.type == C_FUNCTION) {
+                dead = !live.contains(c.name);
+                removed += dead;
+            }
+            if (!dead) {
+                kept.push_back(move(c));
+            }
+        }
+        file.commands.swap(kept);
+    }
+    return removed;
+}
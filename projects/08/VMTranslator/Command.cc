@@ -0,0 +1,78 @@
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+enum CommandType {
+    C_ARITHMETIC,
+    C_PUSH,
+    C_POP,
+    C_LABEL,
+    C_GOTO,
+    C_IF,
+    C_FUNCTION,
+    C_RETURN,
+    C_CALL,
+
+    // fused by the optimizer, C_TAIL_CALL by fuseTailCalls
+    C_MOVE,        // push segment arg2 / pop target targetIndex
+    C_UPDATE,      // push segment arg2 / push constant k / op / pop segment arg2
+    C_BRANCH,      // [op] [not] if-goto name
+    C_ARRAY_STORE, // pop temp 0 / pop pointer 1 / push temp 0 / pop that 0
+    C_TAIL_CALL    // call name arg2 / return
+};
+
+// eq, gt and lt are kept together, see CodeWriter::compareIndex
+enum Operator {
+    OP_ADD,
+    OP_SUB,
+    OP_NEG,
+    OP_EQ,
+    OP_GT,
+    OP_LT,
+    OP_AND,
+    OP_OR,
+    OP_NOT,
+    OP_NONE
+};
+
+enum Segment {
+    S_CONSTANT,
+    S_LOCAL,
+    S_ARGUMENT,
+    S_THIS,
+    S_THAT,
+    S_TEMP,
+    S_STATIC,
+    S_POINTER
+};
+
+// VM spellings in enum order
+constexpr string_view operatorNames[] = {
+    "add", "sub", "neg", "eq", "gt", "lt", "and", "or", "not", ""
+};
+
+constexpr string_view segmentNames[] = {
+    "constant", "local", "argument", "this", "that", "temp", "static", "pointer"
+};
+
+// Command
+// one VM command, the unit passed from Parser to CodeWriter
+struct Command {
+    CommandType type;
+    Operator op = OP_NONE;         // C_ARITHMETIC, C_UPDATE: add/sub, C_BRANCH: eq/gt/lt or none
+    Segment segment = S_CONSTANT;  // push/pop, C_MOVE source, C_UPDATE slot
+    int arg2 = 0;                  // index, nVars or nArgs
+    string name;                   // label or function name; for a static slot
+                                   // inlined from another file, that file
+
+    bool negate = false;           // C_BRANCH jumps when the condition is false
+    Segment target = S_CONSTANT;   // C_MOVE destination segment
+    int targetIndex = 0;           // C_MOVE destination index, C_UPDATE constant
+};
+
+// the commands of one .vm file, name without the extension
+struct SourceFile {
+    string name;
+    vector<Command> commands;
+};
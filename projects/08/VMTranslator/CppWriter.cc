@@ -0,0 +1,449 @@
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <stdexcept>
+using namespace std;
+
+// runtime of the generated program; the frame code matches the Hack
+// translation, so a run leaves the same RAM behind. SP is passed from
+// function to function instead of living in RAM[0], so it stays in a
+// register
+constexpr string_view cppPrelude = R"(#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+int16_t ram[32768];
+unsigned long long steps = 0;
+unsigned long long maxSteps = ~0ull;
+
+// stopped: the --steps budget ran out instead
+struct Halt {
+    int sp;
+    bool stopped = false;
+};
+
+struct UndefinedFunction : std::runtime_error {
+    int sp;
+    UndefinedFunction(const char* name, int sp):
+        std::runtime_error(std::string("call to undefined function ") + name), sp(sp) {}
+};
+
+inline int16_t& at(int address) { return ram[address & 0x7FFF]; }
+inline void push(int& sp, int value) { at(sp++) = int16_t(value); }
+inline int16_t pop(int& sp) { return at(--sp); }
+
+// a backward jump or a call, counted against --steps
+inline void step(int sp) {
+    if (steps == maxSteps) {
+        throw Halt{sp, true};
+    }
+    steps++;
+}
+
+// push returnAddress, LCL, ARG, THIS, THAT; the callee is called natively
+inline int enter(int sp, int nArgs, int returnAddress) {
+    at(sp) = int16_t(returnAddress);
+    at(sp + 1) = ram[1];
+    at(sp + 2) = ram[2];
+    at(sp + 3) = ram[3];
+    at(sp + 4) = ram[4];
+    ram[2] = int16_t(sp - nArgs);
+    ram[1] = int16_t(sp + 5);
+    return sp + 5;
+}
+
+// pops the frame, value replaces the arguments; the caller's SP
+inline int leave(int16_t value) {
+    int frame = ram[1];
+    at(ram[2]) = value;
+    int sp = ram[2] + 1;
+    ram[4] = at(frame - 1);
+    ram[3] = at(frame - 2);
+    ram[2] = at(frame - 3);
+    ram[1] = at(frame - 4);
+    return sp;
+}
+
+}  // namespace
+
+)";
+
+constexpr string_view cppMain = R"(
+int main(int argc, char* argv[]) {
+    std::vector<int> outputs;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg(argv[i]), value(argv[i + 1]);
+        if (arg == "--set" && value.find('=') != std::string::npos) {
+            size_t eq = value.find('=');
+            at(std::stoi(value.substr(0, eq))) = int16_t(std::stoi(value.substr(eq + 1)));
+        } else if (arg == "--steps") {
+            maxSteps = std::stoull(value);
+        } else if (arg == "--print") {
+            for (size_t start = 0; start <= value.size(); ) {
+                size_t comma = std::min(value.find(',', start), value.size());
+                outputs.push_back(std::stoi(value.substr(start, comma - start)));
+                start = comma + 1;
+            }
+        } else {
+            std::fprintf(stderr, "%s [--set <a>=<v>]... [--print <a>[,<b>...]] [--steps <n>]\n", argv[0]);
+            return 1;
+        }
+    }
+    bool stopped = false;
+    try {
+        ram[0] = int16_t(run(ram[0]));
+    } catch (const Halt& h) {
+        ram[0] = int16_t(h.sp);
+        stopped = h.stopped;
+    } catch (const UndefinedFunction& e) {
+        ram[0] = int16_t(e.sp);
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    for (int address : outputs) {
+        std::printf("RAM[%d] = %d\n", address, at(address));
+    }
+    std::fprintf(stderr, "%s after %llu backward jumps and calls\n", stopped ? "stopped" : "halted", steps);
+}
+)";
+
+struct CppStats {
+    size_t functions = 0;
+    size_t undefined = 0;
+};
+
+// CppWriter
+// Lowers a whole VM program to one self-contained C++17 source file.
+// Every VM function becomes a C++ function over a global 32K-word RAM,
+// its labels become goto labels, and call/return build and pop the Hack
+// frame around a native C++ call. The return address word holds the
+// call site's number. A goto to the label right before it halts the
+// program, as does returning from the function it started in. Other
+// endless loops, e.g. Jack's Sys.halt, run until --steps backward jumps
+// and calls were taken.
+// Static slots get RAM addresses from 16 on in order of first use.
+//
+// Within a basic block, values pushed are C++ locals and only reach the
+// RAM stack at the next label, jump, call or return, so e.g. push /
+// push / lt / if-goto is one comparison. A function reads LCL and ARG
+// once on entry: only call and return change them, and return restores
+// them.
+class CppWriter {
+private:
+  OutputSink& out;
+  CppStats& stats;
+  unordered_map<string, int> functionIds;
+  vector<string> functionNames;  // by id
+  unordered_map<string, int> statics;
+  int callSites = 0;
+
+  // the function being written
+  string body;
+  vector<string> pending;  // stack values not stored yet, bottom first
+  int temps = 0;
+  bool inFunction = false;  // LCL and ARG read once on entry
+  bool usesLcl = false;
+  bool usesArg = false;
+
+  void line(const string& text) {
+      body += text;
+      body += '\n';
+  }
+
+  void writeOut() {
+      out.write(string_view(body));
+      body.clear();
+  }
+
+  int functionId(const string& name) {
+      auto [it, added] = functionIds.try_emplace(name, functionNames.size());
+      if (added) {
+          functionNames.push_back(name);
+      }
+      return it->second;
+  }
+
+  string functionSymbol(const string& name) {
+      return "f" + to_string(functionId(name));
+  }
+
+  // ram[a] for a fixed slot, at(pointer + i) for the others
+  string slot(const Command& c, const string& file) {
+      switch (c.segment) {
+      case S_LOCAL:
+          usesLcl = true;
+          return (inFunction ? "at(lcl + " : "at(ram[1] + ") + to_string(c.arg2) + ")";
+      case S_ARGUMENT:
+          usesArg = true;
+          return (inFunction ? "at(arg + " : "at(ram[2] + ") + to_string(c.arg2) + ")";
+      case S_THIS: return "at(ram[3] + " + to_string(c.arg2) + ")";
+      case S_THAT: return "at(ram[4] + " + to_string(c.arg2) + ")";
+      case S_TEMP:
+          if (c.arg2 < 0 || c.arg2 > 7) {
+              throw invalid_argument(file + ": temp " + to_string(c.arg2) + " is invalid.");
+          }
+          return "ram[" + to_string(5 + c.arg2) + "]";
+      case S_POINTER:
+          if (c.arg2 < 0 || c.arg2 > 1) {
+              throw invalid_argument(file + ": pointer " + to_string(c.arg2) + " is invalid.");
+          }
+          return "ram[" + to_string(3 + c.arg2) + "]";
+      case S_STATIC: {
+          // a static inlined from another file keeps that file's slot
+          string owner = c.name.empty() ? file : c.name;
+          auto [it, added] = statics.try_emplace(owner + "." + to_string(c.arg2), 16 + statics.size());
+          return "ram[" + to_string(it->second) + "]";
+      }
+      default:
+          throw invalid_argument(file + ": pop constant is invalid.");
+      }
+  }
+
+  // a new local holding value, read now
+  string temp(const string& value) {
+      string t = "t" + to_string(temps++);
+      line("    " + t + " = " + value + ";");
+      return t;
+  }
+
+  string popValue() {
+      if (pending.empty()) {
+          return temp("pop(sp)");
+      }
+      string value = pending.back();
+      pending.pop_back();
+      return value;
+  }
+
+  void flush() {
+      for (const string& value : pending) {
+          line("    push(sp, " + value + ");");
+      }
+      pending.clear();
+  }
+
+  void writeArithmetic(Operator op) {
+      if (op == OP_NEG || op == OP_NOT) {
+          string x = popValue();
+          pending.push_back(temp(op == OP_NEG ? "int16_t(-" + x + ")" : "int16_t(~" + x + ")"));
+          return;
+      }
+      string y = popValue();
+      string x = popValue();
+      switch (op) {
+      case OP_ADD: pending.push_back(temp("int16_t(" + x + " + " + y + ")")); break;
+      case OP_SUB: pending.push_back(temp("int16_t(" + x + " - " + y + ")")); break;
+      case OP_EQ: pending.push_back(temp(x + " == " + y + " ? -1 : 0")); break;
+      case OP_GT: pending.push_back(temp(x + " > " + y + " ? -1 : 0")); break;
+      case OP_LT: pending.push_back(temp(x + " < " + y + " ? -1 : 0")); break;
+      case OP_AND: pending.push_back(temp("int16_t(" + x + " & " + y + ")")); break;
+      case OP_OR: pending.push_back(temp("int16_t(" + x + " | " + y + ")")); break;
+      default: break;
+      }
+  }
+
+  // label L / goto L
+  static bool halts(const SourceFile& file, size_t begin, size_t i) {
+      return i > begin && file.commands[i - 1].type == C_LABEL && file.commands[i - 1].name == file.commands[i].name;
+  }
+
+  // body of one function or of a file's commands before its first
+  // function, commands [begin, end), into body; returns the locals it
+  // needs declared
+  string writeBody(const SourceFile& file, size_t begin, size_t end) {
+      // VM labels are local to their function, and so are C++ labels;
+      // only the ones jumped to are written
+      unordered_map<string, int> labels;
+      unordered_set<string> targets;
+      for (size_t i = begin; i < end; i++) {
+          const Command& c = file.commands[i];
+          if (c.type == C_LABEL) {
+              labels.try_emplace(c.name, labels.size());
+          } else if (c.type == C_IF || (c.type == C_GOTO && !halts(file, begin, i))) {
+              targets.insert(c.name);
+          }
+      }
+      auto label = [&](const string& name) {
+          auto it = labels.find(name);
+          if (it == labels.end()) {
+              throw invalid_argument(file.name + ": label " + name + " is not defined.");
+          }
+          return "L" + to_string(it->second);
+      };
+
+      pending.clear();
+      temps = 0;
+      inFunction = file.commands[begin].type == C_FUNCTION;
+      usesLcl = usesArg = false;
+      unordered_set<string> behind;  // labels a jump goes back to
+      bool ended = false;
+      for (size_t i = begin; i < end; i++) {
+          const Command& c = file.commands[i];
+          ended = c.type == C_GOTO || c.type == C_RETURN;
+          switch (c.type) {
+          case C_ARITHMETIC:
+              writeArithmetic(c.op);
+              break;
+          case C_PUSH:
+              pending.push_back(c.segment == S_CONSTANT ? to_string(c.arg2) : temp(slot(c, file.name)));
+              break;
+          case C_POP: {
+              string value = popValue();
+              line("    " + slot(c, file.name) + " = " + value + ";");
+              break;
+          }
+          case C_LABEL:
+              flush();
+              behind.insert(c.name);
+              if (targets.contains(c.name)) {
+                  line(label(c.name) + ":;");
+              }
+              break;
+          case C_GOTO:
+              flush();
+              if (halts(file, begin, i)) {
+                  line("    throw Halt{sp};");
+              } else if (behind.contains(c.name)) {
+                  line("    step(sp);");
+                  line("    goto " + label(c.name) + ";");
+              } else {
+                  line("    goto " + label(c.name) + ";");
+              }
+              break;
+          case C_IF: {
+              string condition = popValue();
+              flush();
+              if (behind.contains(c.name)) {
+                  line("    if (" + condition + ") { step(sp); goto " + label(c.name) + "; }");
+              } else {
+                  line("    if (" + condition + ") goto " + label(c.name) + ";");
+              }
+              break;
+          }
+          case C_FUNCTION:
+              if (c.arg2 > 0) {
+                  line("    for (int i = 0; i < " + to_string(c.arg2) + "; i++) push(sp, 0);");
+              }
+              break;
+          case C_CALL:
+              flush();
+              line("    step(sp);");
+              line("    sp = " + functionSymbol(c.name) + "(enter(sp, " + to_string(c.arg2) + ", "
+                   + to_string(++callSites) + "));  // " + c.name);
+              break;
+          case C_RETURN: {
+              // what else is pending is dropped by the return anyway
+              string value = popValue();
+              pending.clear();
+              line("    return leave(" + value + ");");
+              break;
+          }
+          default:
+              throw invalid_argument(file.name + ": unexpected command.");
+          }
+      }
+      flush();
+      // running into the next function is left to the Hack translation
+      if (!ended && inFunction) {
+          line("    throw Halt{sp};");
+      }
+
+      string locals;
+      if (inFunction && usesLcl) {
+          locals += "    const int lcl = ram[1];\n";
+      }
+      if (inFunction && usesArg) {
+          locals += "    const int arg = ram[2];\n";
+      }
+      if (temps > 0) {
+          locals += "    int16_t t0";
+          for (int t = 1; t < temps; t++) {
+              locals += ", t" + to_string(t);
+          }
+          locals += ";\n";
+      }
+      return locals;
+  }
+
+public:
+    CppWriter(OutputSink& out, CppStats& stats):
+      out(out),
+      stats(stats) {}
+
+    // bootstrap runs "call Sys.init 0" with SP=256 as the translated
+    // directory does; without it the program starts at its first command
+    void write(const vector<SourceFile>& files, bool bootstrap) {
+        CallGraph graph(files);
+        out.write(cppPrelude);
+
+        // ids in order of first mention, every function declared up front
+        if (bootstrap) {
+            functionId("Sys.init");
+        }
+        for (const SourceFile& file : files) {
+            for (const Command& c : file.commands) {
+                if (c.type == C_FUNCTION || c.type == C_CALL) {
+                    functionId(c.name);
+                }
+            }
+        }
+        for (size_t id = 0; id < functionNames.size(); id++) {
+            line("int f" + to_string(id) + "(int sp);  // " + functionNames[id]);
+        }
+        writeOut();
+
+        for (size_t f = 0; f < files.size(); f++) {
+            const vector<Command>& commands = files[f].commands;
+            for (size_t i = 0; i < commands.size(); i++) {
+                if (commands[i].type != C_FUNCTION || graph.at(commands[i].name).file != f
+                    || graph.at(commands[i].name).begin != i) {
+                    continue;
+                }
+                const FunctionInfo& info = graph.at(commands[i].name);
+                string locals = writeBody(files[f], info.begin, info.end);
+                out.write(string_view("\n// " + commands[i].name + "\nint " + functionSymbol(commands[i].name) + "([[maybe_unused]] int sp) {\n"));
+                out.write(string_view(locals));
+                writeOut();
+                out.write("}\n");
+                stats.functions++;
+            }
+        }
+
+        // SP=256 comes with the bootstrap
+        out.write(bootstrap ? "\nint run(int) {\n" : "\nint run(int sp) {\n");
+        if (bootstrap) {
+            line("    return " + functionSymbol("Sys.init") + "(enter(256, 0, 0));");
+        } else if (!files.empty() && !files[0].commands.empty() && files[0].commands[0].type == C_FUNCTION) {
+            // its frame was set up by whoever runs the program
+            line("    return " + functionSymbol(files[0].commands[0].name) + "(sp);");
+        } else if (!files.empty()) {
+            size_t end = 0;
+            while (end < files[0].commands.size() && files[0].commands[end].type != C_FUNCTION) {
+                end++;
+            }
+            out.write(string_view(writeBody(files[0], 0, end)));
+            line("    return sp;");
+        }
+        writeOut();
+        out.write("}\n");
+
+        // called but defined nowhere, e.g. the OS of a Jack program
+        for (size_t id = 0; id < functionNames.size(); id++) {
+            if (!graph.contains(functionNames[id])) {
+                line("\nint f" + to_string(id) + "(int sp) {");
+                line("    throw UndefinedFunction(\"" + functionNames[id] + "\", sp);");
+                line("}");
+                stats.undefined++;
+            }
+        }
+        writeOut();
+        out.write(cppMain);
+    }
+};
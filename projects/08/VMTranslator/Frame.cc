@@ -0,0 +1,104 @@
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Frame
+// The words a call to one function saves for its caller, in this order:
+// return address, LCL, ARG, THIS, THAT. The standard frame has all five
+// with LCL pointing past it. THIS and THAT are left out for a function
+// that never pops to pointer 0/1 itself, since every call it makes
+// restores whatever that callee changes. A function without locals that
+// every call passes the same number of arguments keeps its caller's LCL;
+// its frame is then found from ARG, right above the arguments.
+struct Frame {
+    bool saveLcl = true;
+    bool saveThis = true;
+    bool saveThat = true;
+    int nArgs = 0;  // of every call, when !saveLcl
+
+    int size() const {
+        return 2 + saveLcl + saveThis + saveThat;
+    }
+
+    bool saves(string_view pointer) const {
+        return pointer == "LCL" ? saveLcl : pointer == "THIS" ? saveThis : pointer == "THAT" ? saveThat : true;
+    }
+
+    bool full() const {
+        return saveLcl && saveThis && saveThat;
+    }
+
+    bool operator==(const Frame&) const = default;
+};
+
+struct FrameStats {
+    size_t functions = 0;
+    size_t withoutLcl = 0;
+    size_t withoutThis = 0;
+    size_t withoutThat = 0;
+};
+
+// the frame of every function in files that needs less than the standard
+// one; root keeps the standard frame the bootstrap call lays out, which
+// the 08 tests check down to the stack addresses
+unordered_map<string, Frame> analyzeFrames(const vector<SourceFile>& files, const string& root,
+                                           FrameStats& stats) {
+    // nArgs of every call, -1 when calls disagree
+    unordered_map<string, int> nArgs;
+    for (const SourceFile& file : files) {
+        for (const Command& c : file.commands) {
+            if (c.type == C_CALL) {
+                auto [it, added] = nArgs.try_emplace(c.name, c.arg2);
+                if (!added && it->second != c.arg2) {
+                    it->second = -1;
+                }
+            }
+        }
+    }
+
+    unordered_map<string, Frame> frames;
+    CallGraph graph(files);
+    for (const SourceFile& file : files) {
+        for (size_t i = 0; i < file.commands.size(); i++) {
+            const Command& f = file.commands[i];
+            if (f.type != C_FUNCTION || !graph.contains(f.name)) {
+                continue;
+            }
+            const FunctionInfo& info = graph.at(f.name);
+            if (&files[info.file] != &file || info.begin != i) {
+                continue;
+            }
+            stats.functions++;
+            if (f.name == root) {
+                continue;
+            }
+
+            Frame frame{false, false, false};
+            for (size_t j = info.begin + 1; j < info.end; j++) {
+                const Command& c = file.commands[j];
+                if (c.type == C_POP && c.segment == S_POINTER) {
+                    (c.arg2 == 0 ? frame.saveThis : frame.saveThat) = true;
+                }
+                if ((c.type == C_PUSH || c.type == C_POP) && c.segment == S_LOCAL) {
+                    frame.saveLcl = true;
+                }
+            }
+            auto calls = nArgs.find(f.name);
+            if (f.arg2 > 0 || calls == nArgs.end() || calls->second < 0) {
+                frame.saveLcl = true;
+            } else if (!frame.saveLcl) {
+                frame.nArgs = calls->second;
+            }
+
+            stats.withoutLcl += !frame.saveLcl;
+            stats.withoutThis += !frame.saveThis;
+            stats.withoutThat += !frame.saveThat;
+            if (!frame.full()) {
+                frames.emplace(f.name, frame);
+            }
+        }
+    }
+    return frames;
+}
@@ -0,0 +1,277 @@
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+using namespace std;
+
+struct InlineStats {
+    size_t sites = 0;
+    size_t functions = 0; // distinct callees inlined at least once
+};
+
+// Inliner
+// Replaces calls to small leaf functions with the callee's body. The
+// arguments are popped into locals appended to the caller's frame, the
+// callee's own locals follow them, and THIS/THAT are saved there too when
+// the callee changes them, so the frame code of the call is not needed.
+// A callee qualifies when it makes no calls, ends with a return and
+// provably leaves exactly its return value on the stack at every return.
+// Calls in the root function stay: it runs once, and the bootstrap lays
+// out its frame, which the 08 tests check down to the stack addresses.
+class Inliner {
+private:
+  struct Callee {
+      const SourceFile* file;
+      int nVars;
+      int nArgs;          // arguments the body reads or writes
+      bool writesThis;
+      bool writesThat;
+      vector<Command> body; // without the function command
+  };
+
+  vector<SourceFile>& files;
+  string root;
+  size_t maxSize;
+  InlineStats& stats;
+  unordered_map<string, Callee> callees;
+
+  // stack depth at every return is 1 and never below 0, with every label
+  // reached at one known depth
+  static bool isBalanced(const vector<Command>& body) {
+      unordered_map<string, int> labels;
+      int depth = 0;
+      bool reachable = true;
+      auto reach = [&](const string& label, int d) {
+          auto [it, added] = labels.try_emplace(label, d);
+          return added || it->second == d;
+      };
+      for (const Command& c : body) {
+          if (c.type == C_LABEL) {
+              if (reachable && !reach(c.name, depth)) {
+                  return false;
+              }
+              if (!labels.contains(c.name)) {
+                  return false;
+              }
+              depth = labels[c.name];
+              reachable = true;
+              continue;
+          }
+          if (!reachable) {
+              continue;
+          }
+          switch (c.type) {
+          case C_PUSH:
+              depth++;
+              break;
+          case C_POP:
+              depth--;
+              break;
+          case C_ARITHMETIC:
+              depth -= c.op == OP_NEG || c.op == OP_NOT ? 0 : 1;
+              break;
+          case C_IF:
+              depth--;
+              if (depth < 0 || !reach(c.name, depth)) {
+                  return false;
+              }
+              break;
+          case C_GOTO:
+              if (!reach(c.name, depth)) {
+                  return false;
+              }
+              reachable = false;
+              break;
+          case C_RETURN:
+              if (depth != 1) {
+                  return false;
+              }
+              reachable = false;
+              break;
+          default:
+              return false;
+          }
+          if (depth < 0) {
+              return false;
+          }
+      }
+      return !reachable;
+  }
+
+  void findCallees() {
+      CallGraph graph(files);
+      for (const SourceFile& file : files) {
+          for (size_t i = 0; i < file.commands.size(); i++) {
+              const Command& f = file.commands[i];
+              if (f.type != C_FUNCTION || !graph.contains(f.name)) {
+                  continue;
+              }
+              const FunctionInfo& info = graph.at(f.name);
+              if (&files[info.file] != &file || info.begin != i || !info.callees.empty()
+                  || info.end - info.begin - 1 > maxSize
+                  || file.commands[info.end - 1].type != C_RETURN) {
+                  continue;
+              }
+              Callee callee{};
+              callee.file = &file;
+              callee.nVars = f.arg2;
+              callee.body.assign(file.commands.begin() + info.begin + 1, file.commands.begin() + info.end);
+              for (const Command& c : callee.body) {
+                  if (c.type == C_PUSH || c.type == C_POP) {
+                      if (c.segment == S_ARGUMENT) {
+                          callee.nArgs = max(callee.nArgs, c.arg2 + 1);
+                      }
+                      if (c.type == C_POP && c.segment == S_POINTER) {
+                          (c.arg2 == 0 ? callee.writesThis : callee.writesThat) = true;
+                      }
+                  }
+              }
+              if (isBalanced(callee.body)) {
+                  callees.emplace(f.name, move(callee));
+              }
+          }
+      }
+  }
+
+  static Command slot(CommandType type, Segment segment, int index) {
+      Command c{};
+      c.type = type;
+      c.segment = segment;
+      c.arg2 = index;
+      return c;
+  }
+
+  // frame slots used from local base on, appended to out in place of
+  // "call name nArgs" as the site-th inlined call of the caller
+  int expand(const string& name, const Callee& f, int nArgs, int base, int site,
+             const SourceFile& caller, vector<Command>& out) {
+      int locals = base + nArgs;
+      int savedThis = locals + f.nVars;
+      int savedThat = savedThis + f.writesThis;
+      string suffix = "." + to_string(site);
+
+      for (int i = nArgs - 1; i >= 0; i--) {
+          out.push_back(slot(C_POP, S_LOCAL, base + i));
+      }
+      for (int j = 0; j < f.nVars; j++) {
+          out.push_back(slot(C_PUSH, S_CONSTANT, 0));
+          out.push_back(slot(C_POP, S_LOCAL, locals + j));
+      }
+      if (f.writesThis) {
+          out.push_back(slot(C_PUSH, S_POINTER, 0));
+          out.push_back(slot(C_POP, S_LOCAL, savedThis));
+      }
+      if (f.writesThat) {
+          out.push_back(slot(C_PUSH, S_POINTER, 1));
+          out.push_back(slot(C_POP, S_LOCAL, savedThat));
+      }
+
+      string end = name + "$RETURN" + suffix;
+      bool jumpsToEnd = false;
+      for (size_t i = 0; i < f.body.size(); i++) {
+          Command c = f.body[i];
+          switch (c.type) {
+          case C_PUSH:
+          case C_POP:
+              if (c.segment == S_ARGUMENT) {
+                  c.segment = S_LOCAL;
+                  c.arg2 += base;
+              } else if (c.segment == S_LOCAL) {
+                  c.arg2 += locals;
+              } else if (c.segment == S_STATIC && f.file != &caller) {
+                  // statics stay in the callee's file
+                  c.name = f.file->name;
+              }
+              break;
+          case C_LABEL:
+          case C_GOTO:
+          case C_IF:
+              c.name = name + "$" + c.name + suffix;
+              break;
+          case C_RETURN:
+              if (i + 1 == f.body.size()) {
+                  continue;
+              }
+              c = Command{};
+              c.type = C_GOTO;
+              c.name = end;
+              jumpsToEnd = true;
+              break;
+          default:
+              break;
+          }
+          out.push_back(move(c));
+      }
+      if (jumpsToEnd) {
+          Command label{};
+          label.type = C_LABEL;
+          label.name = end;
+          out.push_back(label);
+      }
+
+      // the return value stays on top
+      if (f.writesThis) {
+          out.push_back(slot(C_PUSH, S_LOCAL, savedThis));
+          out.push_back(slot(C_POP, S_POINTER, 0));
+      }
+      if (f.writesThat) {
+          out.push_back(slot(C_PUSH, S_LOCAL, savedThat));
+          out.push_back(slot(C_POP, S_POINTER, 1));
+      }
+      return nArgs + f.nVars + f.writesThis + f.writesThat;
+  }
+
+  // every site in a function shares the same appended locals
+  void inlineFile(SourceFile& file, unordered_set<string>& used) {
+      vector<Command> out;
+      out.reserve(file.commands.size());
+      size_t function = SIZE_MAX;
+      int base = 0;
+      int extra = 0;
+      int site = 0;
+      bool isRoot = false;
+      auto finishFunction = [&]() {
+          if (function != SIZE_MAX) {
+              out[function].arg2 += extra;
+          }
+      };
+      for (Command& c : file.commands) {
+          if (c.type == C_FUNCTION) {
+              finishFunction();
+              function = out.size();
+              base = c.arg2;
+              extra = 0;
+              site = 0;
+              isRoot = c.name == root;
+          } else if (c.type == C_CALL && function != SIZE_MAX && !isRoot && callees.contains(c.name)
+                     && c.arg2 >= callees.at(c.name).nArgs) {
+              extra = max(extra, expand(c.name, callees.at(c.name), c.arg2, base, site++, file, out));
+              used.insert(c.name);
+              stats.sites++;
+              continue;
+          }
+          out.push_back(move(c));
+      }
+      finishFunction();
+      file.commands.swap(out);
+  }
+
+public:
+    Inliner(vector<SourceFile>& files, const string& root, size_t maxSize, InlineStats& stats):
+      files(files),
+      root(root),
+      maxSize(maxSize),
+      stats(stats) {}
+
+    void run() {
+        findCallees();
+        if (callees.empty()) {
+            return;
+        }
+        unordered_set<string> used;
+        for (SourceFile& file : files) {
+            inlineFile(file, used);
+        }
+        stats.functions = used.size();
+    }
+};
@@ -0,0 +1,220 @@
+#include <string>
+#include <vector>
+using namespace std;
+
+struct PeepholeStats {
+    size_t moves = 0;
+    size_t updates = 0;
+    size_t branches = 0;
+    size_t arrayStores = 0;
+    size_t constants = 0;
+    size_t dead = 0;
+};
+
+// PeepholeOptimizer
+// Rewrites the commands of one file before code generation. Known windows
+// of stack code become fused commands that CodeWriter translates without
+// going through the stack, and commands that can never run are dropped.
+class PeepholeOptimizer {
+private:
+  vector<Command>& commands;
+  PeepholeStats& stats;
+
+  bool matches(size_t i, CommandType type, Segment segment, int arg2) const {
+      return i < commands.size() && commands[i].type == type
+          && commands[i].segment == segment && commands[i].arg2 == arg2;
+  }
+
+  bool matches(size_t i, Operator op) const {
+      return i < commands.size() && commands[i].type == C_ARITHMETIC && commands[i].op == op;
+  }
+
+  bool isPush(size_t i) const {
+      return i < commands.size() && commands[i].type == C_PUSH;
+  }
+
+  bool isPop(size_t i) const {
+      return i < commands.size() && commands[i].type == C_POP && commands[i].segment != S_CONSTANT;
+  }
+
+  // a static of another file, see Inliner
+  bool isForeignStatic(size_t i) const {
+      return commands[i].segment == S_STATIC && !commands[i].name.empty();
+  }
+
+  static bool isCompare(Operator op) {
+      return op == OP_EQ || op == OP_GT || op == OP_LT;
+  }
+
+  // a goto or return only continues at the next label or function
+  void removeDeadCode() {
+      vector<Command> out;
+      bool reachable = true;
+      for (Command& c : commands) {
+          if (c.type == C_LABEL || c.type == C_FUNCTION) {
+              reachable = true;
+          }
+          if (reachable) {
+              out.push_back(move(c));
+          } else {
+              stats.dead++;
+          }
+          if (c.type == C_GOTO || c.type == C_RETURN) {
+              reachable = false;
+          }
+      }
+      commands.swap(out);
+  }
+
+  // push constant 0 / not and push constant 1 / neg push -1, e.g. Jack's true
+  void foldTrue() {
+      vector<Command> out;
+      for (size_t i = 0; i < commands.size(); i++) {
+          bool minusOne = (matches(i, C_PUSH, S_CONSTANT, 0) && matches(i + 1, OP_NOT))
+              || (matches(i, C_PUSH, S_CONSTANT, 1) && matches(i + 1, OP_NEG));
+          out.push_back(move(commands[i]));
+          if (minusOne) {
+              out.back().arg2 = -1;
+              stats.constants++;
+              i++;
+          }
+      }
+      commands.swap(out);
+  }
+
+  // pop temp 0 / pop pointer 1 / push temp 0 / pop that 0
+  bool fuseArrayStore(size_t i, vector<Command>& out) {
+      if (!matches(i, C_POP, S_TEMP, 0) || !matches(i + 1, C_POP, S_POINTER, 1)
+          || !matches(i + 2, C_PUSH, S_TEMP, 0) || !matches(i + 3, C_POP, S_THAT, 0)) {
+          return false;
+      }
+      Command c{};
+      c.type = C_ARRAY_STORE;
+      out.push_back(c);
+      stats.arrayStores++;
+      return true;
+  }
+
+  // push S i / push constant k / add|sub / pop S i, or with the
+  // constant pushed first for add
+  bool fuseUpdate(size_t i, vector<Command>& out) {
+      if (!isPush(i) || !isPush(i + 1) || !isPop(i + 3)
+          || i + 2 >= commands.size() || commands[i + 2].type != C_ARITHMETIC) {
+          return false;
+      }
+      Operator op = commands[i + 2].op;
+      const Command* slot = &commands[i];
+      const Command* constant = &commands[i + 1];
+      if (op == OP_ADD && slot->segment == S_CONSTANT) {
+          swap(slot, constant);
+      } else if (op != OP_ADD && op != OP_SUB) {
+          return false;
+      }
+      const Command& pop = commands[i + 3];
+      if (constant->segment != S_CONSTANT || constant->arg2 < 0 || slot->segment == S_CONSTANT
+          || slot->segment != pop.segment || slot->arg2 != pop.arg2 || slot->name != pop.name) {
+          return false;
+      }
+
+      Command c{C_UPDATE, op, slot->segment, slot->arg2, slot->name};
+      c.targetIndex = constant->arg2;
+      out.push_back(c);
+      stats.updates++;
+      return true;
+  }
+
+  // push X / pop Y
+  bool fuseMove(size_t i, vector<Command>& out) {
+      // C_MOVE only has room for the source's file
+      if (!isPush(i) || !isPop(i + 1) || isForeignStatic(i + 1)) {
+          return false;
+      }
+      Command c{C_MOVE, OP_NONE, commands[i].segment, commands[i].arg2, commands[i].name};
+      c.target = commands[i + 1].segment;
+      c.targetIndex = commands[i + 1].arg2;
+      out.push_back(c);
+      stats.moves++;
+      return true;
+  }
+
+  // [eq|gt|lt] [not] if-goto L
+  bool fuseBranch(size_t i, vector<Command>& out) {
+      size_t j = i;
+      Operator op = OP_NONE;
+      if (j < commands.size() && commands[j].type == C_ARITHMETIC && isCompare(commands[j].op)) {
+          op = commands[j++].op;
+      }
+      bool negate = matches(j, OP_NOT);
+      if (negate) {
+          j++;
+      }
+      if (j == i || j >= commands.size() || commands[j].type != C_IF) {
+          return false;
+      }
+
+      Command c{};
+      c.type = C_BRANCH;
+      c.op = op;
+      c.name = commands[j].name;
+      c.negate = negate;
+      out.push_back(c);
+      stats.branches++;
+      return true;
+  }
+
+  size_t windowSize(const Command& c) const {
+      switch (c.type) {
+      case C_ARRAY_STORE:
+      case C_UPDATE:
+          return 4;
+      case C_MOVE:
+          return 2;
+      case C_BRANCH:
+          return 1 + (c.op != OP_NONE) + c.negate;
+      default:
+          return 1;
+      }
+  }
+
+  void fuse() {
+      vector<Command> out;
+      for (size_t i = 0; i < commands.size(); ) {
+          if (fuseArrayStore(i, out) || fuseUpdate(i, out) || fuseMove(i, out) || fuseBranch(i, out)) {
+              i += windowSize(out.back());
+          } else {
+              out.push_back(move(commands[i++]));
+          }
+      }
+      commands.swap(out);
+  }
+
+public:
+    PeepholeOptimizer(vector<Command>& commands, PeepholeStats& stats):
+      commands(commands),
+      stats(stats) {}
+
+    // number of commands removed
+    size_t run() {
+        size_t before = commands.size();
+        removeDeadCode();
+        foldTrue();
+        fuse();
+        return before - commands.size();
+    }
+};
+
+// call f n / return becomes C_TAIL_CALL, returns the number of sites
+size_t fuseTailCalls(vector<Command>& commands) {
+    vector<Command> out;
+    size_t sites = 0;
+    for (size_t i = 0; i < commands.size(); i++) {
+        out.push_back(move(commands[i]));
+        if (out.back().type == C_CALL && i + 1 < commands.size() && commands[i + 1].type == C_RETURN) {
+            out.back().type = C_TAIL_CALL;
+            sites++;
+            i++;
+        }
+    }
+    commands.swap(out);
+    return sites;
+}
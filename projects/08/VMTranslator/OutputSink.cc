@@ -0,0 +1,145 @@
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+// OutputSink
+// Append buffer for the generated assembly. Lines are assembled from their
+// parts without any stream formatting; a file-backed sink writes the buffer
+// out whenever it grows past FLUSH_SIZE, a memory sink just keeps it.
+class OutputSink {
+private:
+  static constexpr size_t FLUSH_SIZE = 1 << 20;
+
+  string buffer;
+  int fd = -1;
+  bool ownsFd = false;
+  size_t instructions = 0;
+
+  void append(string_view s) {
+      buffer.append(s);
+  }
+
+  void append(char c) {
+      buffer.push_back(c);
+  }
+
+  template <typename Int>
+  void appendInt(Int value) {
+      char digits[24];
+      auto [end, ec] = to_chars(digits, digits + sizeof(digits), value);
+      buffer.append(digits, end - digits);
+  }
+
+  void append(int value) {
+      appendInt(value);
+  }
+
+  void append(size_t value) {
+      appendInt(value);
+  }
+
+  template <typename... Parts>
+  void line(const Parts&... parts) {
+      (append(parts), ...);
+      buffer.push_back('\n');
+      if (fd >= 0 && buffer.size() >= FLUSH_SIZE) {
+          flush();
+      }
+  }
+
+public:
+    // in memory
+    OutputSink() {
+        buffer.reserve(FLUSH_SIZE);
+    }
+
+    // already open descriptor, e.g. STDOUT_FILENO
+    OutputSink(int fd): fd(fd) {
+        buffer.reserve(FLUSH_SIZE * 2);
+    }
+
+    OutputSink(const string& path) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw invalid_argument("cannot open " + path);
+        }
+        ownsFd = true;
+        buffer.reserve(FLUSH_SIZE * 2);
+    }
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    ~OutputSink() {
+        try {
+            flush();
+        } catch (const exception&) {
+        }
+        if (ownsFd) {
+            close(fd);
+        }
+    }
+
+    // one Hack instruction
+    template <typename... Parts>
+    void emit(const Parts&... parts) {
+        instructions++;
+        line(parts...);
+    }
+
+    // (name)
+    template <typename... Parts>
+    void label(const Parts&... parts) {
+        line('(', parts..., ')');
+    }
+
+    // "// ..." line
+    template <typename... Parts>
+    void comment(const Parts&... parts) {
+        line("// ", parts...);
+    }
+
+    // raw text
+    void write(string_view text) {
+        append(text);
+        if (fd >= 0 && buffer.size() >= FLUSH_SIZE) {
+            flush();
+        }
+    }
+
+    // contents of a memory sink, instructions included
+    void write(const OutputSink& other) {
+        write(string_view(other.str()));
+        instructions += other.instructions;
+    }
+
+    void flush() {
+        if (fd < 0) {
+            return;
+        }
+        const char* p = buffer.data();
+        size_t left = buffer.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd, p, left);
+            if (n <= 0) {
+                throw runtime_error("write failed");
+            }
+            p += n;
+            left -= n;
+        }
+        buffer.clear();
+    }
+
+    // buffered text of a memory sink
+    const string& str() const {
+        return buffer;
+    }
+
+    size_t instructionCount() const {
+        return instructions;
+    }
+};
@@ -0,0 +1,335 @@
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include "./Command.cc"
+#include "./Bytecode.cc"
+using namespace std;
+
+// keywords
+// Every VM keyword and segment name is at most 8 characters, so each one
+// packs into a single 64-bit key. The tables are perfect hashes over those
+// keys with the multiplier searched for at compile time, as in the
+// assembler's Code.cc.
+struct Keyword {
+    string_view word;
+    CommandType type;
+    Operator op;
+};
+
+constexpr array<Keyword, 17> keywords = {{
+      {"add",      C_ARITHMETIC, OP_ADD},
+      {"sub",      C_ARITHMETIC, OP_SUB},
+      {"neg",      C_ARITHMETIC, OP_NEG},
+      {"eq",       C_ARITHMETIC, OP_EQ},
+      {"gt",       C_ARITHMETIC, OP_GT},
+      {"lt",       C_ARITHMETIC, OP_LT},
+      {"and",      C_ARITHMETIC, OP_AND},
+      {"or",       C_ARITHMETIC, OP_OR},
+      {"not",      C_ARITHMETIC, OP_NOT},
+      {"push",     C_PUSH,       OP_NONE},
+      {"pop",      C_POP,        OP_NONE},
+      {"label",    C_LABEL,      OP_NONE},
+      {"goto",     C_GOTO,       OP_NONE},
+      {"if-goto",  C_IF,         OP_NONE},
+      {"function", C_FUNCTION,   OP_NONE},
+      {"call",     C_CALL,       OP_NONE},
+      {"return",   C_RETURN,     OP_NONE}
+}};
+
+constexpr uint64_t packWord(string_view s) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < s.size(); i++) {
+        key |= uint64_t(uint8_t(s[i])) << (8 * i);
+    }
+    return key;
+}
+
+template <size_t N, int Bits>
+class WordHash {
+private:
+  static constexpr size_t Size = size_t(1) << Bits;
+  static constexpr uint64_t EMPTY = 0; // no word packs to 0
+
+  array<uint64_t, Size> keys{};
+  array<uint8_t, Size> values{};
+  uint64_t seed = 0;
+
+  static constexpr size_t slot(uint64_t key, uint64_t seed) {
+      return (key * seed) >> (64 - Bits);
+  }
+
+  constexpr bool tryBuild(const array<string_view, N>& words, uint64_t candidate) {
+      keys.fill(EMPTY);
+      for (size_t w = 0; w < N; w++) {
+          uint64_t key = packWord(words[w]);
+          size_t i = slot(key, candidate);
+          if (keys[i] != EMPTY) {
+              return false;
+          }
+          keys[i] = key;
+          values[i] = w;
+      }
+      seed = candidate;
+      return true;
+  }
+
+public:
+    constexpr WordHash(const array<string_view, N>& words) {
+        for (uint64_t candidate = 0x9E3779B97F4A7C15; ; candidate += 0x9E3779B97F4A7C15 * 2) {
+            if (tryBuild(words, candidate | 1)) {
+                return;
+            }
+        }
+    }
+
+    // position of the word in the table's list, -1 when unknown
+    constexpr int find(string_view word) const {
+        if (word.empty() || word.size() > 8) {
+            return -1;
+        }
+        uint64_t key = packWord(word);
+        size_t i = slot(key, seed);
+        return keys[i] == key ? values[i] : -1;
+    }
+};
+
+constexpr WordHash<17, 6> keywordTable([] {
+    array<string_view, 17> words;
+    for (size_t i = 0; i < keywords.size(); i++) {
+        words[i] = keywords[i].word;
+    }
+    return words;
+}());
+
+constexpr WordHash<8, 4> segmentTable(to_array(segmentNames));
+
+static_assert(keywords[keywordTable.find("if-goto")].type == C_IF);
+static_assert(keywords[keywordTable.find("not")].op == OP_NOT);
+static_assert(segmentTable.find("argument") == S_ARGUMENT && segmentTable.find("pointer") == S_POINTER);
+static_assert(keywordTable.find("push1") == -1 && segmentTable.find("thus") == -1);
+
+// character classes
+constexpr array<bool, 256> makeVmChars() {
+    array<bool, 256> table{};
+    for (int c = 'a'; c <= 'z'; c++) table[c] = true;
+    for (int c = 'A'; c <= 'Z'; c++) table[c] = true;
+    for (int c = '0'; c <= '9'; c++) table[c] = true;
+    for (char c : string_view("-._$")) {
+        table[static_cast<uint8_t>(c)] = true;
+    }
+    return table;
+}
+
+constexpr array<bool, 256> vmChars = makeVmChars();
+
+inline bool isCharSet(char c) {
+    return vmChars[static_cast<uint8_t>(c)];
+}
+
+// Tokenizer
+// words of a whole .vm text as views into it, comments skipped
+class Tokenizer {
+private:
+  string_view text;
+  size_t pos = 0;
+  int line = 1;
+
+public:
+    Tokenizer(string_view text): text(text) {}
+
+    // empty at the end of the text
+    string_view next() {
+        while (pos < text.size()) {
+            char c = text[pos];
+            if (isCharSet(c)) {
+                size_t start = pos;
+                while (pos < text.size() && isCharSet(text[pos])) {
+                    pos++;
+                }
+                return text.substr(start, pos - start);
+            }
+
+            if (c == '/' && pos + 1 < text.size() && text[pos + 1] == '/') {
+                size_t eol = text.find('\n', pos);
+                pos = eol == string_view::npos ? text.size() : eol;
+                continue;
+            }
+
+            if (c == '\n') {
+                line++;
+            }
+            pos++;
+        }
+        return {};
+    }
+
+    int lineNumber() const {
+        return line;
+    }
+};
+
+// Parser
+// decodes each command once into its enums and operands; anything that
+// isn't a VM command is an error
+class Parser {
+private:
+  Tokenizer tokenizer;
+  string_view source;   // file name for error messages
+  bool moreCommands = false;
+  string_view keyword;
+  Command current;
+
+  [[noreturn]] void fail(const string& what, string_view token) {
+      throw invalid_argument(string(source) + ":" + to_string(tokenizer.lineNumber())
+                             + ": " + what + " '" + string(token) + "'");
+  }
+
+  string_view operand() {
+      string_view token = tokenizer.next();
+      if (token.empty()) {
+          fail("missing operand after", keyword);
+      }
+      return token;
+  }
+
+  int number() {
+      string_view token = operand();
+      int value = 0;
+      auto [end, ec] = from_chars(token.data(), token.data() + token.size(), value);
+      if (ec != errc() || end != token.data() + token.size()) {
+          fail("invalid number", token);
+      }
+      return value;
+  }
+
+  Segment segment() {
+      string_view token = operand();
+      int s = segmentTable.find(token);
+      if (s < 0) {
+          fail("unknown segment", token);
+      }
+      return Segment(s);
+  }
+
+public:
+    Parser(string_view text, string_view source = "vm"): tokenizer(text), source(source) {
+        // find first command
+        advance();
+    }
+
+    bool hasMoreCommands() const {
+        return moreCommands;
+    }
+
+    void advance() {
+        string_view token = tokenizer.next();
+        moreCommands = !token.empty();
+        if (!moreCommands) {
+            return;
+        }
+
+        int k = keywordTable.find(token);
+        if (k < 0) {
+            fail("unknown command", token);
+        }
+        keyword = token;
+        current.type = keywords[k].type;
+        current.op = keywords[k].op;
+        current.segment = S_CONSTANT;
+        current.arg2 = 0;
+        current.name.clear();
+        switch (current.type) {
+        case C_PUSH:
+        case C_POP:
+            current.segment = segment();
+            current.arg2 = number();
+            break;
+        case C_LABEL:
+        case C_GOTO:
+        case C_IF:
+            current.name = operand();
+            break;
+        case C_FUNCTION:
+        case C_CALL:
+            current.name = operand();
+            current.arg2 = number();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // valid until the next advance()
+    const Command& command() const {
+        return current;
+    }
+};
+
+// bytecode
+// .vmb opcodes are positions in keywords, segment ids are Segment values
+constexpr bool matchesBytecode() {
+    for (size_t i = 0; i < keywords.size(); i++) {
+        if (keywords[i].word != vmbOpcodeNames[i]) return false;
+    }
+    for (size_t i = 0; i < VMB_SEGMENTS; i++) {
+        if (segmentNames[i] != vmbSegmentNames[i]) return false;
+    }
+    return keywords.size() == VMB_OPCODES;
+}
+
+static_assert(matchesBytecode());
+
+// the commands of a .vmb image, no text involved
+vector<Command> decodeBytecode(string_view data, string_view source = "vmb") {
+    BytecodeReader reader(data);
+    vector<Command> commands(reader.size());
+    for (size_t i = 0; i < reader.size(); i++) {
+        VmbInstruction in = reader.at(i);
+        if (in.opcode >= VMB_OPCODES || in.segment >= VMB_SEGMENTS) {
+            throw invalid_argument(string(source) + ": bad instruction " + to_string(i));
+        }
+        Command& c = commands[i];
+        c.type = keywords[in.opcode].type;
+        c.op = keywords[in.opcode].op;
+        switch (c.type) {
+        case C_PUSH:
+        case C_POP:
+            c.segment = Segment(in.segment);
+            c.arg2 = in.index;
+            break;
+        case C_LABEL:
+        case C_GOTO:
+        case C_IF:
+            c.name = reader.name(in.name);
+            break;
+        case C_FUNCTION:
+        case C_CALL:
+            c.name = reader.name(in.name);
+            c.arg2 = in.index;
+            break;
+        default:
+            break;
+        }
+    }
+    return commands;
+}
+
+// .vmb image of parsed (not fused) commands
+string encodeBytecode(const vector<Command>& commands) {
+    BytecodeWriter writer;
+    for (const Command& c : commands) {
+        if (c.type == C_ARITHMETIC) {
+            writer.add(c.op);
+            continue;
+        }
+        uint8_t opcode = VMB_PUSH;
+        while (opcode < VMB_OPCODES && keywords[opcode].type != c.type) {
+            opcode++;
+        }
+        writer.add(opcode, c.segment, c.arg2, c.name);
+    }
+    return writer.bytes();
+}
@@ -0,0 +1,53 @@
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include "../../06/assembler/MappedFile.cc"
+#include "./Parser.cc"
+using namespace std;
+
+// a .vm or .vmb file, named after the file without its extension
+SourceFile readSourceFile(const string& path) {
+    MappedFile file(path);
+    if (!file.is_open()) {
+        throw invalid_argument("file not found: " + path);
+    }
+    SourceFile source{};
+    source.name = filesystem::path(path).stem().string();
+    if (path.ends_with(".vmb")) {
+        source.commands = decodeBytecode(file.view(), path);
+        return source;
+    }
+
+    // Phase 1 Parsing, the whole text at once
+    Parser p(file.view(), path);
+    while (p.hasMoreCommands()) {
+        source.commands.push_back(p.command());
+        p.advance();
+    }
+    return source;
+}
+
+// the .vm and .vmb files of a directory in path order; a class with
+// both uses the newer one
+vector<SourceFile> readDirectory(const string& path) {
+    map<filesystem::path, filesystem::path> files;
+    for (auto &p : filesystem::recursive_directory_iterator(path)) {
+        if (p.path().extension() != ".vm" && p.path().extension() != ".vmb") {
+            continue;
+        }
+        filesystem::path stem = p.path();
+        stem.replace_extension();
+        auto [it, added] = files.try_emplace(stem, p.path());
+        if (!added && filesystem::last_write_time(p.path()) > filesystem::last_write_time(it->second)) {
+            it->second = p.path();
+        }
+    }
+    // directory order is unspecified
+    vector<SourceFile> sources;
+    for (auto& [stem, file] : files) {
+        sources.push_back(readSourceFile(file.string()));
+    }
+    return sources;
+}
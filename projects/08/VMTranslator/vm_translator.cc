@@ -4,708 +4,1743 @@
 #include <iostream>
 #include <vector>
 #include <stdexcept>
+#include <map>
 #include <unordered_map>
 #include <bitset>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include "./OutputSink.cc"
+#include "./SourceReader.cc"
+#include "./Optimizer.cc"
+#include "./CallGraph.cc"
+#include "./Inliner.cc"
+#include "./Frame.cc"
+#include "./CppWriter.cc"
 using namespace std;
 
-enum CommandType {
-    C_ARITHMETIC,
-    C_PUSH,
-    C_POP,
-    C_LABEL,
-    C_GOTO,
-    C_IF,
-    C_FUNCTION,
-    C_RETURN,
-    C_CALL
-};
-
 // static
-bool isCharSet(char c) {
-    return isalpha(c) || isdigit(c)
-      || c == '-'
-      || c == '.'
-      || c == '_'
-      || c == '$'
-    ;
-}
-
-bool isArithmeticOps(string& token) {
-    return token == "eq"
-        || token == "add"
-        || token == "sub"
-        || token == "lt"
-        || token == "gt"
-        || token == "neg"
-        || token == "and"
-        || token == "or"
-        || token == "not";
-}
-
-bool isStackOps(string& token) {
-    return token == "push" || token == "pop";
-}
-
-bool isLabelOps(string& token) {
-    return token == "label";
-}
-
-bool isIf(string& token) {
-    return token == "if-goto";
-}
-
-bool isGoto(string& token) {
-    return token == "goto";
-}
-
-bool isFunction(string& token) {
-    return token == "function";
-}
-
-bool isCall(string& token) {
-    return token == "call";
-}
-
-bool isReturn(string& token) {
-    return token == "return";
-}
-
-string getSegmentPointers(const string& segment) {
-    if (segment == "local") return "LCL";
-    if (segment == "argument") return "ARG";
-    if (segment == "this") return "THIS";
-    if (segment == "that") return "THAT";
-    if (segment == "temp") return "5";
-    throw invalid_argument("segment: " + segment + " is invalid.");
+string_view getSegmentPointers(Segment segment) {
+    switch (segment) {
+    case S_LOCAL: return "LCL";
+    case S_ARGUMENT: return "ARG";
+    case S_THIS: return "THIS";
+    case S_THAT: return "THAT";
+    case S_TEMP: return "5";
+    default: throw invalid_argument("segment: " + string(segmentNames[segment]) + " is invalid.");
+    }
 }
 
-string getThisOrThat(int index) {
+string_view getThisOrThat(int index) {
     return index == 0 ? "THIS" : "THAT";
 }
 
-// Tokenizer
-class Tokenizer {
-private:
-    ifstream& file;
-
-public:
-    Tokenizer(ifstream& file): file(file) {}
-
-    string next() {
-        string token = "";
-        string discard;
-        while(file) {
-            char c = file.get();
-            if (c == '/' && file.peek() == '/') {
-                getline(file, discard);
-                continue;
-            }
-
-            if (isCharSet(c)) {
-                token += c;
-
-                if (!isCharSet(file.peek())) {
-                    return token;
-                }
-            }
-        }
-
-        return "EOF";
-    }
-};
-
-// Parser
-class Parser {
-private:
-    Tokenizer tokenizer;
-
-    bool moreCommands;
-    CommandType cType;
-    string firstArg;
-    string secondArg;
-
-public:
-    Parser(ifstream& file): tokenizer(file) {
-        if (!file.is_open()) {
-            throw invalid_argument("file not found");
-        }
-
-        // find first command
-        advance();
-    }
-
-    bool hasMoreCommands() {
-        return moreCommands;
-    }
-
-    void advance() {
-        moreCommands = false;
-        while(true) {
-            string token = tokenizer.next();
-            if (token == "EOF") {
-                return;
-            }
-
-            if (isArithmeticOps(token)) {
-                cType = C_ARITHMETIC;
-                moreCommands = true;
-                firstArg = token;
-                return;
-            } else if (isStackOps(token)) {
-                cType = token == "push" ? C_PUSH: C_POP;
-                firstArg = tokenizer.next();
-                secondArg = tokenizer.next();
-                moreCommands = true;
-                return;
-            } else if (isLabelOps(token)) {
-                cType = C_LABEL;
-                firstArg = tokenizer.next();
-                moreCommands = true;
-                return;
-            } else if (isIf(token)) {
-                cType = C_IF;
-                firstArg = tokenizer.next();
-                moreCommands = true;
-                return;
-            } else if (isGoto(token)) {
-                cType = C_GOTO;
-                firstArg = tokenizer.next();
-                moreCommands = true;
-                return;
-            } else if (isFunction(token)) {
-                cType = C_FUNCTION;
-                firstArg = tokenizer.next();
-                secondArg = tokenizer.next();
-                moreCommands = true;
-                return;
-            } else if (isCall(token)) {
-                cType = C_CALL;
-                firstArg = tokenizer.next();
-                secondArg = tokenizer.next();
-                moreCommands = true;
-                return;
-            } else if (isReturn(token)) {
-                cType = C_RETURN;
-                moreCommands = true;
-                return;
-            }
-        }
-    }
-
-    int commandType() {
-        return cType;
-    }
-
-    string arg1() {
-        return firstArg;
-    }
-
-    int arg2() {
-        return stoi(secondArg);
-    }
+// options
+struct TranslatorOptions {
+    // calls and returns jump to one shared routine instead of expanding
+    // the frame code at every site
+    bool sharedCall = false;
+    // eq/gt/lt call one routine per operator, return address in D
+    bool sharedCompare = false;
+    // fuse common command windows before code generation
+    bool optimize = false;
+    // keep the top of the stack in D between labels, calls and returns
+    bool cacheTos = false;
+    // one SP update per basic block, stack slots addressed from SP
+    bool batchSp = false;
+    // drop functions a directory's Sys.init never reaches
+    bool dce = false;
+    // inline leaf functions of at most this many commands, 0 for none
+    size_t inlineSize = 0;
+    // call f n / return reuses the caller's frame
+    bool tailCall = false;
+    // zero three or more locals in a loop instead of unrolled
+    bool sizePrologue = false;
+    // save only what each function's callers need, see Frame
+    bool elideFrames = false;
+    // files of a directory translated in parallel
+    int threads = 1;
+    // a C++ program instead of Hack assembly, see CppWriter
+    bool cppTarget = false;
 };
 
 class CodeWriter {
 private:
+  OutputSink& out;
+  TranslatorOptions options;
   string filename;
+  string labelPrefix;     // keeps generated labels unique per file
+  string currentFunction;
   int arithmeticCounter;
   int callCounter;
 
+  // shared call/return bookkeeping
+  int sharedCalls = 0;
+  int sharedReturns = 0;
+  size_t callSiteInstructions = 0;
+  size_t returnSiteInstructions = 0;
+
+  // shared compare bookkeeping, sites per operator in compareOps order
+  static constexpr Operator compareOps[3] = {OP_EQ, OP_GT, OP_LT};
+  int compareSites[3] = {0, 0, 0};
+  size_t compareSiteInstructions = 0;
+
+  PeepholeStats peephole;
+  size_t tailCalls = 0;
+
+  // functions whose calls save less than the standard frame
+  shared_ptr<const unordered_map<string, Frame>> frames;
+
+  // with cacheTos, true while the top of the VM stack is held in D
+  // instead of RAM[SP-1]; SP does not count it
+  bool cached = false;
+
+  // with batchSp, the words pushed (or popped, when negative) since SP
+  // was last written back
+  int depth = 0;
+  static constexpr int MAX_WALK = 2;
+
+  static int compareIndex(Operator op) {
+      return op >= OP_EQ && op <= OP_LT ? op - OP_EQ : -1;
+  }
+
+  static string upper(Operator op) {
+      string name(operatorNames[op]);
+      for (char& c : name) {
+          c = toupper(c);
+      }
+      return name;
+  }
+
+  // R13 = callee, R14 = nArgs, D = return address
+  void writeSharedCall(const string& funcName, int numVars, const string& returnAddress) {
+      size_t before = out.instructionCount();
+      out.emit("@", funcName);
+      out.emit("D=A");
+      out.emit("@R13");
+      out.emit("M=D");
+      out.emit("@R14");
+      if (numVars == 0 || numVars == 1) {
+          out.emit(numVars == 0 ? "M=0" : "M=1");
+      } else {
+          out.emit("@", numVars);
+          out.emit("D=A");
+          out.emit("@R14");
+          out.emit("M=D");
+      }
+      out.emit("@", returnAddress);
+      out.emit("D=A");
+      out.emit("@VM$CALL");
+      out.emit("0;JMP");
+      out.label(returnAddress);
+      callSiteInstructions += out.instructionCount() - before;
+      sharedCalls++;
+  }
+
+  void writeCallRoutine() {
+      out.comment("shared call");
+      out.label("VM$CALL");
+
+      // push returnAddress
+      out.emit("@SP");
+      out.emit("AM=M+1");
+      out.emit("A=A-1");
+      out.emit("M=D");
+
+      // push LCL, ARG, THIS, THAT
+      for (const char* pointer : {"LCL", "ARG", "THIS", "THAT"}) {
+          out.emit("@", pointer);
+          out.emit("D=M");
+          out.emit("@SP");
+          out.emit("AM=M+1");
+          out.emit("A=A-1");
+          out.emit("M=D");
+      }
+
+      // repos ARG = SP - 5 - nArgs
+      out.emit("@R14");
+      out.emit("D=M");
+      out.emit("@5");
+      out.emit("D=D+A");
+      out.emit("@SP");
+      out.emit("D=M-D");
+      out.emit("@ARG");
+      out.emit("M=D");
+
+      // repos LCL
+      out.emit("@SP");
+      out.emit("D=M");
+      out.emit("@LCL");
+      out.emit("M=D");
+
+      // goto callee
+      out.emit("@R13");
+      out.emit("A=M");
+      out.emit("0;JMP");
+  }
+
+  void writeReturnBody() {
+      // endFrame = LCL
+      out.emit("@LCL");
+      out.emit("D=M");
+      out.emit("@END_FRAME");
+      out.emit("M=D");
+
+      // retAddr = *(endFrame - 5)
+      out.emit("@5");
+      out.emit("D=A");
+      out.emit("@END_FRAME");
+      out.emit("A=M-D");
+      out.emit("D=M");
+      out.emit("@RET_ADDR");
+      out.emit("M=D");
+
+      // *ARG = pop()
+      out.emit("@SP");
+      out.emit("AM=M-1");
+      out.emit("D=M");
+      out.emit("@ARG");
+      out.emit("A=M");
+      out.emit("M=D");
+
+      // SP = ARG + 1
+      out.emit("@ARG");
+      out.emit("D=M");
+      out.emit("@SP");
+      out.emit("M=D+1");
+
+      // THAT = *(endFrame - 1)
+      out.emit("@1");
+      out.emit("D=A");
+      out.emit("@END_FRAME");
+      out.emit("A=M-D");
+      out.emit("D=M");
+      out.emit("@THAT");
+      out.emit("M=D");
+
+      // THIS = *(endFrame - 2)
+      out.emit("@2");
+      out.emit("D=A");
+      out.emit("@END_FRAME");
+      out.emit("A=M-D");
+      out.emit("D=M");
+      out.emit("@THIS");
+      out.emit("M=D");
+
+      // ARG = *(endFrame - 3)
+      out.emit("@3");
+      out.emit("D=A");
+      out.emit("@END_FRAME");
+      out.emit("A=M-D");
+      out.emit("D=M");
+      out.emit("@ARG");
+      out.emit("M=D");
+
+      // LCL = *(endFrame - 4)
+      out.emit("@4");
+      out.emit("D=A");
+      out.emit("@END_FRAME");
+      out.emit("A=M-D");
+      out.emit("D=M");
+      out.emit("@LCL");
+      out.emit("M=D");
+
+      // goto retAddr
+      out.emit("@RET_ADDR");
+      out.emit("A=M");
+      out.emit("0;JMP");
+  }
+
+  void writeSharedCompare(Operator command) {
+      size_t before = out.instructionCount();
+      string name = upper(command);
+      out.emit("@", labelPrefix, name, "_RETURN.", arithmeticCounter);
+      out.emit("D=A");
+      out.emit("@VM$", name);
+      out.emit("0;JMP");
+      out.label(labelPrefix, name, "_RETURN.", arithmeticCounter);
+      compareSiteInstructions += out.instructionCount() - before;
+      compareSites[compareIndex(command)]++;
+  }
+
+  // pops y and x, leaves x == y on the stack and jumps back through R15
+  void writeEqRoutine() {
+      out.comment("shared eq");
+      out.label("VM$EQ");
+      out.emit("@R15");
+      out.emit("M=D");
+      out.emit("@SP");
+      out.emit("AM=M-1");
+      out.emit("D=M");
+      out.emit("A=A-1");
+      out.emit("D=M-D");
+      out.emit("M=-1");
+      out.emit("@VM$EQ.TRUE");
+      out.emit("D;JEQ");
+      out.emit("@SP");
+      out.emit("A=M-1");
+      out.emit("M=0");
+      out.label("VM$EQ.TRUE");
+      out.emit("@R15");
+      out.emit("A=M");
+      out.emit("0;JMP");
+  }
+
+  // gt/lt. x - y overflows when the signs differ, so that case is decided
+  // by the signs alone and only same-sign operands are subtracted
+  void writeOrderRoutine(Operator command) {
+      string name = "VM$" + upper(command);
+      string jump = command == OP_GT ? "D;JGT" : "D;JLT";
+      // x < 0 <= y is true for lt, x >= 0 > y is true for gt
+      string xNegative = name + (command == OP_LT ? ".TRUE" : ".FALSE");
+      string xPositive = name + (command == OP_GT ? ".TRUE" : ".FALSE");
+
+      out.comment("shared ", operatorNames[command]);
+      out.label(name);
+      out.emit("@R15");
+      out.emit("M=D");
+      out.emit("@SP");
+      out.emit("AM=M-1");
+      out.emit("D=M");
+      out.emit("@", name, ".YNEG");
+      out.emit("D;JLT");
+
+      // y >= 0
+      out.emit("@SP");
+      out.emit("A=M-1");
+      out.emit("D=M");
+      out.emit("@", xNegative);
+      out.emit("D;JLT");
+      out.emit("@", name, ".SAME");
+      out.emit("0;JMP");
+
+      // y < 0
+      out.label(name, ".YNEG");
+      out.emit("@SP");
+      out.emit("A=M-1");
+      out.emit("D=M");
+      out.emit("@", xPositive);
+      out.emit("D;JGE");
+
+      out.label(name, ".SAME");
+      out.emit("@SP");
+      out.emit("A=M");
+      out.emit("D=M");
+      out.emit("A=A-1");
+      out.emit("D=M-D");
+      out.emit("@", name, ".TRUE");
+      out.emit(jump);
+
+      out.label(name, ".FALSE");
+      out.emit("@SP");
+      out.emit("A=M-1");
+      out.emit("M=0");
+      out.emit("@R15");
+      out.emit("A=M");
+      out.emit("0;JMP");
+
+      out.label(name, ".TRUE");
+      out.emit("@SP");
+      out.emit("A=M-1");
+      out.emit("M=-1");
+      out.emit("@R15");
+      out.emit("A=M");
+      out.emit("0;JMP");
+  }
+
+  void writeCompareRoutine(Operator command) {
+      if (command == OP_EQ) {
+          writeEqRoutine();
+      } else {
+          writeOrderRoutine(command);
+      }
+  }
+
+  // VM labels are local to their function
+  string scoped(const string& label) const {
+      return currentFunction.empty() ? label : currentFunction + "$" + label;
+  }
+
+  // slots whose address can be loaded into A without touching D
+  static bool isDirect(Segment segment, int index) {
+      return segment == S_STATIC || segment == S_TEMP || segment == S_POINTER || index <= 2;
+  }
+
+  // A = address of segment[index], clobbers D unless isDirect. file names
+  // the owner of a static slot when it isn't the current file
+  void selectSlot(Segment segment, int index, string_view file = {}) {
+      if (segment == S_STATIC) {
+          out.emit("@", file.empty() ? filename : file, ".", index);
+      } else if (segment == S_TEMP) {
+          out.emit("@R", 5 + index);
+      } else if (segment == S_POINTER) {
+          out.emit("@", getThisOrThat(index));
+      } else if (index <= 2) {
+          out.emit("@", getSegmentPointers(segment));
+          out.emit(index == 0 ? "A=M" : "A=M+1");
+          if (index == 2) {
+              out.emit("A=A+1");
+          }
+      } else {
+          out.emit("@", index);
+          out.emit("D=A");
+          out.emit("@", getSegmentPointers(segment));
+          out.emit("A=M+D");
+      }
+  }
+
+  // R13 = address of segment[index]
+  void saveSlotAddress(Segment segment, int index) {
+      out.emit("@", index);
+      out.emit("D=A");
+      out.emit("@", getSegmentPointers(segment));
+      out.emit("D=M+D");
+      out.emit("@R13");
+      out.emit("M=D");
+  }
+
+  // D = segment[index]
+  void loadValue(Segment segment, int index, string_view file = {}) {
+      if (segment == S_CONSTANT) {
+          if (index >= -1 && index <= 1) {
+              out.emit(index == 0 ? "D=0" : index == 1 ? "D=1" : "D=-1");
+          } else {
+              out.emit("@", index);
+              out.emit("D=A");
+          }
+      } else {
+          selectSlot(segment, index, file);
+          out.emit("D=M");
+      }
+  }
+
+  void writeMove(const Command& c) {
+      out.comment("push ", segmentNames[c.segment], " ", c.arg2,
+                  " / pop ", segmentNames[c.target], " ", c.targetIndex);
+      if (isDirect(c.target, c.targetIndex)) {
+          loadValue(c.segment, c.arg2, c.name);
+          selectSlot(c.target, c.targetIndex);
+      } else {
+          saveSlotAddress(c.target, c.targetIndex);
+          loadValue(c.segment, c.arg2, c.name);
+          out.emit("@R13");
+          out.emit("A=M");
+      }
+      out.emit("M=D");
+  }
+
+  // segment[index] += k or -= k in place
+  void writeUpdate(const Command& c) {
+      int k = c.targetIndex;
+      bool add = c.op == OP_ADD;
+      out.comment(segmentNames[c.segment], " ", c.arg2, add ? " += " : " -= ", k);
+      if (k == 0) {
+          return;
+      }
+      if (k == 1) {
+          selectSlot(c.segment, c.arg2, c.name);
+          out.emit(add ? "M=M+1" : "M=M-1");
+          return;
+      }
+      if (isDirect(c.segment, c.arg2)) {
+          out.emit("@", k);
+          out.emit("D=A");
+          selectSlot(c.segment, c.arg2, c.name);
+      } else {
+          saveSlotAddress(c.segment, c.arg2);
+          out.emit("@", k);
+          out.emit("D=A");
+          out.emit("@R13");
+          out.emit("A=M");
+      }
+      out.emit(add ? "M=D+M" : "M=M-D");
+  }
+
+  // the jump taken on D = x - y for an eq/gt/lt branch
+  static string branchJump(const Command& c) {
+      if (c.op == OP_EQ) {
+          return c.negate ? "D;JNE" : "D;JEQ";
+      } else if (c.op == OP_GT) {
+          return c.negate ? "D;JLE" : "D;JGT";
+      }
+      return c.negate ? "D;JGE" : "D;JLT";
+  }
+
+  // jumps on the comparison itself instead of pushing its result
+  void writeBranch(const Command& c) {
+      out.comment(operatorNames[c.op], c.negate ? " not" : "", " if-goto ", c.name);
+      string jump;
+      if (c.op == OP_NONE) {
+          // not / if-goto: not x is nonzero unless x is -1
+          out.emit("@SP");
+          out.emit("AM=M-1");
+          out.emit("D=M+1");
+          jump = "D;JNE";
+      } else if (c.op != OP_EQ && options.sharedCompare) {
+          // x - y overflows for operands of opposite sign, the shared
+          // routine doesn't; branch on the flag it leaves
+          writeSharedCompare(c.op);
+          arithmeticCounter++;
+          out.emit("@SP");
+          out.emit("AM=M-1");
+          out.emit("D=M");
+          jump = c.negate ? "D;JEQ" : "D;JNE";
+      } else {
+          // D = x - y
+          out.emit("@SP");
+          out.emit("AM=M-1");
+          out.emit("D=M");
+          out.emit("@SP");
+          out.emit("AM=M-1");
+          out.emit("D=M-D");
+          jump = branchJump(c);
+      }
+      out.emit("@", scoped(c.name));
+      out.emit(jump);
+  }
+
+  // *addr = value for a stack of [addr, value], leaving temp 0 and THAT
+  // as the four separate commands would
+  void writeArrayStore() {
+      out.comment("pop temp 0 / pop pointer 1 / push temp 0 / pop that 0");
+      out.emit("@SP");
+      out.emit("AM=M-1");
+      out.emit("D=M");
+      out.emit("@R5");
+      out.emit("M=D");
+      out.emit("@SP");
+      out.emit("AM=M-1");
+      out.emit("D=M");
+      out.emit("@THAT");
+      out.emit("M=D");
+      out.emit("@R5");
+      out.emit("D=M");
+      out.emit("@THAT");
+      out.emit("A=M");
+      out.emit("M=D");
+  }
+
+  void spill() {
+      if (cached) {
+          out.emit("@SP");
+          out.emit("AM=M+1");
+          out.emit("A=A-1");
+          out.emit("M=D");
+          cached = false;
+      }
+  }
+
+  void fill() {
+      if (!cached) {
+          out.emit("@SP");
+          out.emit("AM=M-1");
+          out.emit("D=M");
+          cached = true;
+      }
+  }
+
+  // segment[index] = D
+  void storeValue(Segment segment, int index, string_view file = {}) {
+      if (segment == S_CONSTANT) {
+          throw invalid_argument("pop constant not supported");
+      }
+      if (isDirect(segment, index)) {
+          selectSlot(segment, index, file);
+          out.emit("M=D");
+          return;
+      }
+      out.emit("@R14");
+      out.emit("M=D");
+      saveSlotAddress(segment, index);
+      out.emit("@R14");
+      out.emit("D=M");
+      out.emit("@R13");
+      out.emit("A=M");
+      out.emit("M=D");
+  }
+
+  void writeCachedArithmetic(Operator command) {
+      out.comment(operatorNames[command]);
+      if (compareIndex(command) >= 0 && options.sharedCompare) {
+          spill();
+          writeSharedCompare(command);
+          arithmeticCounter++;
+          return;
+      }
+
+      fill();
+      if (command == OP_NEG) {
+          out.emit("D=-D");
+          return;
+      }
+      if (command == OP_NOT) {
+          out.emit("D=!D");
+          return;
+      }
+
+      // x is the word under the cached y
+      out.emit("@SP");
+      out.emit("AM=M-1");
+      switch (command) {
+      case OP_ADD:
+          out.emit("D=D+M");
+          break;
+      case OP_SUB:
+          out.emit("D=M-D");
+          break;
+      case OP_AND:
+          out.emit("D=D&M");
+          break;
+      case OP_OR:
+          out.emit("D=D|M");
+          break;
+      default: {
+          string name = upper(command);
+          out.emit("D=M-D");
+          out.emit("@", labelPrefix, name, "_TRUE.", arithmeticCounter);
+          out.emit(command == OP_EQ ? "D;JEQ" : command == OP_GT ? "D;JGT" : "D;JLT");
+          out.emit("D=0");
+          out.emit("@", labelPrefix, name, "_END.", arithmeticCounter);
+          out.emit("0;JMP");
+          out.label(labelPrefix, name, "_TRUE.", arithmeticCounter);
+          out.emit("D=-1");
+          out.label(labelPrefix, name, "_END.", arithmeticCounter);
+          arithmeticCounter++;
+          break;
+      }
+      }
+  }
+
+  // the cacheTos form of writeCommand. Control flow and the fused commands
+  // that need D start from a spilled stack
+  void writeCachedCommand(const Command& c) {
+      switch (c.type) {
+      case C_PUSH:
+          spill();
+          out.comment("push ", segmentNames[c.segment], " ", c.arg2);
+          loadValue(c.segment, c.arg2, c.name);
+          cached = true;
+          break;
+      case C_POP:
+          out.comment("pop ", segmentNames[c.segment], " ", c.arg2);
+          fill();
+          storeValue(c.segment, c.arg2, c.name);
+          cached = false;
+          break;
+      case C_ARITHMETIC:
+          writeCachedArithmetic(c.op);
+          break;
+      case C_IF:
+          fill();
+          out.emit("@", scoped(c.name));
+          out.emit("D;JNE");
+          cached = false;
+          break;
+      case C_BRANCH:
+          if (c.op == OP_NONE) {
+              out.comment("not if-goto ", c.name);
+              fill();
+              out.emit("D=D+1");
+              out.emit("@", scoped(c.name));
+              out.emit("D;JNE");
+              cached = false;
+          } else if (c.op != OP_EQ && options.sharedCompare) {
+              // the routine pops both operands
+              spill();
+              writeBranch(c);
+          } else {
+              // y is cached, only x is popped
+              out.comment(operatorNames[c.op], c.negate ? " not" : "", " if-goto ", c.name);
+              fill();
+              out.emit("@SP");
+              out.emit("AM=M-1");
+              out.emit("D=M-D");
+              out.emit("@", scoped(c.name));
+              out.emit(branchJump(c));
+              cached = false;
+          }
+          break;
+      default:
+          spill();
+          writeCommand(c);
+          break;
+      }
+  }
+
+  // A = SP + offset, D untouched
+  void selectStack(int offset) {
+      out.emit("@SP");
+      out.emit(offset == 0 ? "A=M" : offset > 0 ? "A=M+1" : "A=M-1");
+      for (int i = 1; i < abs(offset); i++) {
+          out.emit(offset > 0 ? "A=A+1" : "A=A-1");
+      }
+  }
+
+  // SP += depth, clobbers D
+  void commit() {
+      if (depth == 1 || depth == -1) {
+          out.emit("@SP");
+          out.emit(depth > 0 ? "M=M+1" : "M=M-1");
+      } else if (depth != 0) {
+          out.emit("@", abs(depth));
+          out.emit("D=A");
+          out.emit("@SP");
+          out.emit(depth > 0 ? "M=D+M" : "M=M-D");
+      }
+      depth = 0;
+  }
+
+  // commits first when slot SP + offset is too far to walk to
+  void reach(int offset) {
+      if (abs(offset) > MAX_WALK) {
+          commit();
+      }
+  }
+
+  // D = the top word, popped and written back together: the word sits
+  // at the committed SP
+  void popCommitted() {
+      int n = depth - 1;
+      if (n == 0) {
+          out.emit("@SP");
+          out.emit("A=M");
+      } else if (n == 1 || n == -1) {
+          out.emit("@SP");
+          out.emit(n > 0 ? "AM=M+1" : "AM=M-1");
+      } else {
+          out.emit("@", abs(n));
+          out.emit("D=A");
+          out.emit("@SP");
+          out.emit(n > 0 ? "AM=D+M" : "AM=M-D");
+      }
+      out.emit("D=M");
+      depth = 0;
+  }
+
+  void writeBatchedArithmetic(Operator command) {
+      out.comment(operatorNames[command]);
+      if (compareIndex(command) >= 0 && options.sharedCompare) {
+          commit();
+          writeSharedCompare(command);
+          arithmeticCounter++;
+          return;
+      }
+
+      bool unary = command == OP_NEG || command == OP_NOT;
+      reach(unary ? depth - 1 : depth - 2);
+      selectStack(depth - 1);
+      if (command == OP_NEG) {
+          out.emit("M=-M");
+          return;
+      }
+      if (command == OP_NOT) {
+          out.emit("M=!M");
+          return;
+      }
+
+      out.emit("D=M");
+      out.emit("A=A-1");
+      switch (command) {
+      case OP_ADD:
+          out.emit("M=D+M");
+          break;
+      case OP_SUB:
+          out.emit("M=M-D");
+          break;
+      case OP_AND:
+          out.emit("M=D&M");
+          break;
+      case OP_OR:
+          out.emit("M=D|M");
+          break;
+      default: {
+          string name = upper(command);
+          out.emit("D=M-D");
+          out.emit("M=-1");
+          out.emit("@", labelPrefix, name, "_END.", arithmeticCounter);
+          out.emit(command == OP_EQ ? "D;JEQ" : command == OP_GT ? "D;JGT" : "D;JLT");
+          selectStack(depth - 2);
+          out.emit("M=0");
+          out.label(labelPrefix, name, "_END.", arithmeticCounter);
+          arithmeticCounter++;
+          break;
+      }
+      }
+      depth--;
+  }
+
+  // the batchSp form of writeCommand. Stack slots are addressed relative
+  // to the SP in RAM, which is only written back where a basic block ends
+  void writeBatchedCommand(const Command& c) {
+      switch (c.type) {
+      case C_PUSH:
+          out.comment("push ", segmentNames[c.segment], " ", c.arg2);
+          reach(depth);
+          if (c.segment == S_CONSTANT && c.arg2 >= -1 && c.arg2 <= 1) {
+              selectStack(depth);
+              out.emit(c.arg2 == 0 ? "M=0" : c.arg2 == 1 ? "M=1" : "M=-1");
+          } else {
+              loadValue(c.segment, c.arg2, c.name);
+              selectStack(depth);
+              out.emit("M=D");
+          }
+          depth++;
+          break;
+      case C_POP:
+          out.comment("pop ", segmentNames[c.segment], " ", c.arg2);
+          if (c.segment == S_CONSTANT) {
+              throw invalid_argument("pop constant not supported");
+          }
+          reach(depth - 1);
+          if (isDirect(c.segment, c.arg2)) {
+              selectStack(depth - 1);
+              out.emit("D=M");
+              selectSlot(c.segment, c.arg2, c.name);
+          } else {
+              saveSlotAddress(c.segment, c.arg2);
+              selectStack(depth - 1);
+              out.emit("D=M");
+              out.emit("@R13");
+              out.emit("A=M");
+          }
+          out.emit("M=D");
+          depth--;
+          break;
+      case C_ARITHMETIC:
+          writeBatchedArithmetic(c.op);
+          break;
+      case C_IF:
+          out.comment("if-goto ", c.name);
+          popCommitted();
+          out.emit("@", scoped(c.name));
+          out.emit("D;JNE");
+          break;
+      case C_MOVE:
+      case C_UPDATE:
+          // no stack traffic
+          writeCommand(c);
+          break;
+      default:
+          commit();
+          writeCommand(c);
+          break;
+      }
+  }
+
+  Frame frameOf(const string& funcName) const {
+      if (frames) {
+          auto it = frames->find(funcName);
+          if (it != frames->end()) {
+              return it->second;
+          }
+      }
+      return Frame();
+  }
+
+  // D = RAM[RAM[pointer] + offset]
+  void loadFrameWord(string_view pointer, int offset) {
+      out.emit("@", pointer);
+      if (offset >= -1 && offset <= 1) {
+          out.emit(offset == 0 ? "A=M" : offset > 0 ? "A=M+1" : "A=M-1");
+      } else {
+          out.emit("D=M");
+          out.emit("@", abs(offset));
+          out.emit(offset > 0 ? "A=D+A" : "A=D-A");
+      }
+      out.emit("D=M");
+  }
+
+  // writeCall for a function with a reduced frame
+  void writeFrameCall(const Frame& frame, const string& funcName, int numArgs,
+                      const string& returnAddress) {
+      out.emit("@", returnAddress);
+      out.emit("D=A");
+      out.emit("@SP");
+      out.emit("AM=M+1");
+      out.emit("A=A-1");
+      out.emit("M=D");
+      for (string_view pointer : {"LCL", "ARG", "THIS", "THAT"}) {
+          if (!frame.saves(pointer)) {
+              continue;
+          }
+          out.emit("@", pointer);
+          out.emit("D=M");
+          out.emit("@SP");
+          out.emit("AM=M+1");
+          out.emit("A=A-1");
+          out.emit("M=D");
+      }
+
+      // ARG = SP - frame - numArgs
+      out.emit("@SP");
+      out.emit("D=M");
+      out.emit("@", frame.size() + numArgs);
+      out.emit("D=D-A");
+      out.emit("@ARG");
+      out.emit("M=D");
+      if (frame.saveLcl) {
+          out.emit("@SP");
+          out.emit("D=M");
+          out.emit("@LCL");
+          out.emit("M=D");
+      }
+      out.emit("@", funcName);
+      out.emit("0;JMP");
+      out.label(returnAddress);
+  }
+
+  // writeReturn for a function with a reduced frame, which starts at
+  // LCL - size or, without LCL, right above the arguments
+  void writeFrameReturn(const Frame& frame) {
+      string_view base = frame.saveLcl ? "LCL" : "ARG";
+      int start = frame.saveLcl ? -frame.size() : frame.nArgs;
+
+      // the return value may overwrite the return address
+      loadFrameWord(base, start);
+      out.emit("@R13");
+      out.emit("M=D");
+
+      // *ARG = pop(), SP = ARG + 1
+      out.emit("@SP");
+      out.emit("AM=M-1");
+      out.emit("D=M");
+      out.emit("@ARG");
+      out.emit("A=M");
+      out.emit("M=D");
+      out.emit("@ARG");
+      out.emit("D=M");
+      out.emit("@SP");
+      out.emit("M=D+1");
+
+      // the pointer the frame is read through goes last
+      int word = frame.size();
+      for (string_view pointer : {"THAT", "THIS", "ARG", "LCL"}) {
+          if (!frame.saves(pointer)) {
+              continue;
+          }
+          loadFrameWord(base, start + --word);
+          out.emit("@", pointer);
+          out.emit("M=D");
+      }
+      out.emit("@R13");
+      out.emit("A=M");
+      out.emit("0;JMP");
+  }
+
+  void reportPeephole() {
+      cerr << "vm peephole: " << peephole.moves << " moves, " << peephole.updates << " updates, "
+           << peephole.branches << " branches, " << peephole.arrayStores << " array stores, "
+           << peephole.constants << " constants folded, " << peephole.dead << " dead commands removed\n";
+  }
+
+  // ROM used by the compare sites and routines against inline expansion
+  void reportSharedCompare() {
+      size_t sharedRom = compareSiteInstructions;
+      size_t inlineRom = 0;
+      int sites = 0;
+      for (int i = 0; i < 3; i++) {
+          OutputSink scratch;
+          CodeWriter probe(scratch);
+          probe.writeArithmetic(compareOps[i]);
+          inlineRom += compareSites[i] * scratch.instructionCount();
+
+          if (compareSites[i] > 0) {
+              OutputSink routine;
+              CodeWriter shared(routine, options);
+              shared.writeCompareRoutine(compareOps[i]);
+              sharedRom += routine.instructionCount();
+          }
+          sites += compareSites[i];
+      }
+
+      cerr << "shared compare: " << compareSites[0] << " eq, " << compareSites[1] << " gt, "
+           << compareSites[2] << " lt sites\n"
+           << "  ROM: " << sharedRom << " instructions (inline: " << inlineRom << ")\n"
+           << "  saved: " << (long long)inlineRom - (long long)sharedRom << " instructions\n";
+  }
+
+  // ROM and cycle cost of the shared routines against inline expansion,
+  // both are straight-line code so cycles equal instructions executed
+  void reportSharedCall() {
+      OutputSink scratch;
+      CodeWriter probe(scratch);
+      probe.writeCall("f", 2);
+      size_t inlineCall = scratch.instructionCount();
+      probe.writeReturn();
+      size_t inlineReturn = scratch.instructionCount() - inlineCall;
+
+      OutputSink routines;
+      CodeWriter shared(routines, options);
+      shared.writeCallRoutine();
+      size_t callRoutine = routines.instructionCount();
+      shared.writeReturnBody();
+      size_t returnRoutine = routines.instructionCount() - callRoutine;
+
+      size_t sharedRom = callSiteInstructions + returnSiteInstructions
+          + (sharedCalls ? callRoutine : 0) + (sharedReturns ? returnRoutine : 0);
+      size_t inlineRom = sharedCalls * inlineCall + sharedReturns * inlineReturn;
+      double callCycles = sharedCalls ? double(callSiteInstructions) / sharedCalls + callRoutine : 0;
+      double returnCycles = 2 + returnRoutine;
+
+      cerr << "shared call: " << sharedCalls << " call sites, " << sharedReturns << " returns\n"
+           << "  ROM: " << sharedRom << " instructions (inline: " << inlineRom << ")\n"
+           << "  cycles per call: " << callCycles << " (inline: " << inlineCall << ")\n"
+           << "  cycles per return: " << returnCycles << " (inline: " << inlineReturn << ")\n";
+  }
+
 public:
-    CodeWriter():
+    CodeWriter(OutputSink& out, const TranslatorOptions& options = TranslatorOptions()):
+      out(out),
+      options(options),
       arithmeticCounter(0),
       callCounter(0) { }
 
-    void writeArithmetic(const string& command) {
-        cout << "// " << command << "\n";
-        if (command == "add") {
+    void writeArithmetic(Operator command) {
+        out.comment(operatorNames[command]);
+        if (options.sharedCompare && compareIndex(command) >= 0) {
+            writeSharedCompare(command);
+            arithmeticCounter++;
+            return;
+        }
+
+        switch (command) {
+        case OP_ADD:
             // pop first
-            cout << "@SP" << "\n";
-            cout << "A=M-1" << "\n";
-            cout << "D=M" << "\n";
+            out.emit("@SP");
+            out.emit("A=M-1");
+            out.emit("D=M");
 
             // pop second
-            cout << "A=A-1" << "\n";
+            out.emit("A=A-1");
 
             // ops
-            cout << "M=M+D" << "\n";
-
-            cout << "@SP" << "\n";
-            cout << "M=M-1" << "\n";
-        } else if (command == "sub") {
-            cout << "@SP" << "\n";
-            cout << "A=M-1" << "\n";
-            cout << "D=M" << "\n";
-
-            cout << "A=A-1" << "\n";
-            cout << "M=M-D" << "\n";
-
-            cout << "@SP" << "\n";
-            cout << "M=M-1" << "\n";
-        } else if (command == "and") {
-            cout << "@SP" << "\n";
-            cout << "A=M-1" << "\n";
-            cout << "D=M" << "\n";
-
-            cout << "A=A-1" << "\n";
-            cout << "M=M&D" << "\n";
-
-            cout << "@SP" << "\n";
-            cout << "M=M-1" << "\n";
-        } else if (command == "or") {
-            cout << "@SP" << "\n";
-            cout << "A=M-1" << "\n";
-            cout << "D=M" << "\n";
-
-            cout << "A=A-1" << "\n";
-            cout << "M=M|D" << "\n";
-
-            cout << "@SP" << "\n";
-            cout << "M=M-1" << "\n";
-        } else if (command == "eq") {
-            cout << "@SP" << "\n";
-            cout << "A=M-1" << "\n";
-            cout << "D=M" << "\n";
-
-            cout << "A=A-1" << "\n";
-            cout << "D=M-D" << "\n";
-            cout << "M=0" << "\n";
-
-            cout << "@EQ_FALSE." + to_string(arithmeticCounter) << "\n";
-            cout << "D;JNE" << "\n";
-            cout << "@2" << "\n";
-            cout << "D=A" << "\n";
-            cout << "@SP" << "\n";
-            cout << "A=M-D" << "\n";
-            cout << "M=-1" << "\n";
-
-            cout << "(EQ_FALSE." + to_string(arithmeticCounter) + ")" << "\n";
-            cout << "@SP" << "\n";
-            cout << "M=M-1" << "\n";
-        } else if (command == "gt") {
-            cout << "@SP" << "\n";
-            cout << "A=M-1" << "\n";
-            cout << "D=M" << "\n";
-
-            cout << "A=A-1" << "\n";
-            cout << "D=M-D" << "\n";
-            cout << "M=-1" << "\n";
-
-            cout << "@GT_FALSE." + to_string(arithmeticCounter) << "\n";
-            cout << "D;JGT" << "\n";
-            cout << "@2" << "\n";
-            cout << "D=A" << "\n";
-            cout << "@SP" << "\n";
-            cout << "A=M-D" << "\n";
-            cout << "M=0" << "\n";
-
-            cout << "(GT_FALSE." + to_string(arithmeticCounter) + ")" << "\n";
-            cout << "@SP" << "\n";
-            cout << "M=M-1" << "\n";
-        } else if (command == "lt") {
-            cout << "@SP" << "\n";
-            cout << "A=M-1" << "\n";
-            cout << "D=M" << "\n";
-
-            cout << "A=A-1" << "\n";
-            cout << "D=M-D" << "\n";
-            cout << "M=-1" << "\n";
-
-            cout << "@LT_FALSE." + to_string(arithmeticCounter) << "\n";
-            cout << "D;JLT" << "\n";
-            cout << "@2" << "\n";
-            cout << "D=A" << "\n";
-            cout << "@SP" << "\n";
-            cout << "A=M-D" << "\n";
-            cout << "M=0" << "\n";
-
-            cout << "(LT_FALSE." + to_string(arithmeticCounter) + ")" << "\n";
-            cout << "@SP" << "\n";
-            cout << "M=M-1" << "\n";
-        } else if (command == "neg") {
-            cout << "@SP" << "\n";
-            cout << "A=M-1" << "\n";
-            cout << "M=-M" << "\n";
-        } else if (command == "not") {
-            cout << "@SP" << "\n";
-            cout << "A=M-1" << "\n";
-            cout << "M=!M" << "\n";
+            out.emit("M=M+D");
+
+            out.emit("@SP");
+            out.emit("M=M-1");
+            break;
+        case OP_SUB:
+            out.emit("@SP");
+            out.emit("A=M-1");
+            out.emit("D=M");
+
+            out.emit("A=A-1");
+            out.emit("M=M-D");
+
+            out.emit("@SP");
+            out.emit("M=M-1");
+            break;
+        case OP_AND:
+            out.emit("@SP");
+            out.emit("A=M-1");
+            out.emit("D=M");
+
+            out.emit("A=A-1");
+            out.emit("M=M&D");
+
+            out.emit("@SP");
+            out.emit("M=M-1");
+            break;
+        case OP_OR:
+            out.emit("@SP");
+            out.emit("A=M-1");
+            out.emit("D=M");
+
+            out.emit("A=A-1");
+            out.emit("M=M|D");
+
+            out.emit("@SP");
+            out.emit("M=M-1");
+            break;
+        case OP_EQ:
+            out.emit("@SP");
+            out.emit("A=M-1");
+            out.emit("D=M");
+
+            out.emit("A=A-1");
+            out.emit("D=M-D");
+            out.emit("M=0");
+
+            out.emit("@", labelPrefix, "EQ_FALSE.", arithmeticCounter);
+            out.emit("D;JNE");
+            out.emit("@2");
+            out.emit("D=A");
+            out.emit("@SP");
+            out.emit("A=M-D");
+            out.emit("M=-1");
+
+            out.label(labelPrefix, "EQ_FALSE.", arithmeticCounter);
+            out.emit("@SP");
+            out.emit("M=M-1");
+            break;
+        case OP_GT:
+            out.emit("@SP");
+            out.emit("A=M-1");
+            out.emit("D=M");
+
+            out.emit("A=A-1");
+            out.emit("D=M-D");
+            out.emit("M=-1");
+
+            out.emit("@", labelPrefix, "GT_FALSE.", arithmeticCounter);
+            out.emit("D;JGT");
+            out.emit("@2");
+            out.emit("D=A");
+            out.emit("@SP");
+            out.emit("A=M-D");
+            out.emit("M=0");
+
+            out.label(labelPrefix, "GT_FALSE.", arithmeticCounter);
+            out.emit("@SP");
+            out.emit("M=M-1");
+            break;
+        case OP_LT:
+            out.emit("@SP");
+            out.emit("A=M-1");
+            out.emit("D=M");
+
+            out.emit("A=A-1");
+            out.emit("D=M-D");
+            out.emit("M=-1");
+
+            out.emit("@", labelPrefix, "LT_FALSE.", arithmeticCounter);
+            out.emit("D;JLT");
+            out.emit("@2");
+            out.emit("D=A");
+            out.emit("@SP");
+            out.emit("A=M-D");
+            out.emit("M=0");
+
+            out.label(labelPrefix, "LT_FALSE.", arithmeticCounter);
+            out.emit("@SP");
+            out.emit("M=M-1");
+            break;
+        case OP_NEG:
+            out.emit("@SP");
+            out.emit("A=M-1");
+            out.emit("M=-M");
+            break;
+        case OP_NOT:
+            out.emit("@SP");
+            out.emit("A=M-1");
+            out.emit("M=!M");
+            break;
+        default:
+            break;
         }
 
         arithmeticCounter++;
     }
 
-    void writePushPop(int cType, const string& segment, int index) {
-        cout << "// " << (cType == C_PUSH ? "push " : "pop ") << segment << " " << index << "\n";
-        if (segment == "constant") {
-            if (cType == C_PUSH) {
-                cout << "@" + to_string(index) << "\n";
-                cout << "D=A" << "\n";
-                cout << "@SP" << "\n";
-                cout << "AM=M+1" << "\n";
-                cout << "A=A-1" << "\n";
-                cout << "M=D" << "\n";
-            } else {
-                throw invalid_argument("pop constant not supported");
-            }
-        } else if (segment == "local"
-                   || segment == "argument"
-                   || segment == "this"
-                   || segment == "that"
-                   || segment == "temp"
-        ) {
-            string segmentPointer = getSegmentPointers(segment);
-            if (cType == C_POP) {
-                // compute segP+index
-                cout << "@" << to_string(index) << "\n";
-                cout << "D=A" << "\n";
-                cout << "@" << segmentPointer << "\n";
-
-                if (segment == "temp") {
-                    // Base address is hard coded instead of stored in memory
-                  cout << "D=A+D" << "\n";
-                } else {
-                  cout << "D=M+D" << "\n";
-                }
-
-                // store segP+index in R13
-                cout << "@R13" << "\n";
-                cout << "M=D" << "\n";
-
-                // SP--
-                cout << "@SP" << "\n";
-                cout << "M=M-1" << "\n";
-
-                // store *SP in D
-                cout << "A=M" << "\n";
-                cout << "D=M" << "\n";
-
-                // *(segP+index) = *SP
-                cout << "@R13" << "\n";
-                cout << "A=M" << "\n";
-                cout << "M=D" << "\n";
-            } else {
-                // compute segP+index
-                cout << "@" + to_string(index) << "\n";
-                cout << "D=A" << "\n";
-                cout << "@" + segmentPointer << "\n";
-                if (segment == "temp") {
-                    // Base address is hard coded instead of stored in memory
-                  cout << "A=A+D" << "\n";
-                } else {
-                  cout << "A=M+D" << "\n";
-                }
-                cout << "D=M" << "\n";
-
-                // *SP = *(segP+index)
-                cout << "@SP" << "\n";
-                cout << "A=M" << "\n";
-                cout << "M=D" << "\n";
-
-                // SP++
-                cout << "@SP" << "\n";
-                cout << "M=M+1" << "\n";
-            }
-        } else if (segment == "static") {
-            if (cType == C_POP) {
-                // SP--
-                cout << "@SP" << "\n";
-                cout << "M=M-1" << "\n";
-
-                // store *SP in D
-                cout << "A=M" << "\n";
-                cout << "D=M" << "\n";
-
-                // *static.index = *SP
-                cout << "@" << filename + "." + to_string(index) << "\n";
-                cout << "M=D" << "\n";
-            } else {
-                // store *static.index in D
-                cout << "@" << filename + "." + to_string(index) << "\n";
-                cout << "D=M" << "\n";
-
-                // *SP = D
-                cout << "@SP" << "\n";
-                cout << "A=M" << "\n";
-                cout << "M=D" << "\n";
-
-                // SP++
-                cout << "@SP" << "\n";
-                cout << "M=M+1" << "\n";
-            }
-        } else if (segment == "pointer") {
-            string thisOrThat = getThisOrThat(index);
-            if (cType == C_POP) {
-                // SP--
-                cout << "@SP" << "\n";
-                cout << "M=M-1" << "\n";
-
-                // THIS/THAT = *SP
-                cout << "@SP" << "\n";
-                cout << "A=M" << "\n";
-                cout << "D=M" << "\n";
-                cout << "@" << thisOrThat << "\n";
-                cout << "M=D" << "\n";
-            } else {
-                // *SP = THIS/THAT
-                cout << "@" << thisOrThat << "\n";
-                cout << "D=M" << "\n";
-                cout << "@SP" << "\n";
-                cout << "A=M" << "\n";
-                cout << "M=D" << "\n";
-
-                // SP++
-                cout << "@SP" << "\n";
-                cout << "M=M+1" << "\n";
+    void writePushPop(CommandType cType, Segment segment, int index, string_view file = {}) {
+        out.comment(cType == C_PUSH ? "push " : "pop ", segmentNames[segment], " ", index);
+        if (cType == C_PUSH) {
+            // 0, 1 and -1 (folded by -O) are written without D
+            bool small = segment == S_CONSTANT && index >= -1 && index <= 1;
+            if (!small) {
+                loadValue(segment, index, file);
             }
+            out.emit("@SP");
+            out.emit("AM=M+1");
+            out.emit("A=A-1");
+            out.emit(!small ? "M=D" : index == 0 ? "M=0" : index == 1 ? "M=1" : "M=-1");
+        } else if (segment == S_CONSTANT) {
+            throw invalid_argument("pop constant not supported");
+        } else if (isDirect(segment, index)) {
+            out.emit("@SP");
+            out.emit("AM=M-1");
+            out.emit("D=M");
+            selectSlot(segment, index, file);
+            out.emit("M=D");
+        } else {
+            // D = segP+index, then *(segP+index) = *SP through
+            // D = addr + value without a spare register
+            out.emit("@", index);
+            out.emit("D=A");
+            out.emit("@", getSegmentPointers(segment));
+            out.emit("D=M+D");
+            out.emit("@SP");
+            out.emit("AM=M-1");
+            out.emit("D=D+M");
+            out.emit("A=D-M");
+            out.emit("M=D-A");
         }
         arithmeticCounter++;
     }
 
+    // frames from analyzeFrames, used for calls and returns from now on
+    void setFrames(shared_ptr<const unordered_map<string, Frame>> table) {
+        frames = table;
+    }
+
     void setFileName(string name) {
         filename = name;
+        labelPrefix = name.empty() ? "" : name + "$";
     }
 
     void writeInit() {
-        cout << "// SP=256" << "\n";
-        cout << "@256" << "\n";
-        cout << "D=A" << "\n";
-        cout << "@SP" << "\n";
-        cout << "M=D" << "\n";
+        out.comment("SP=256");
+        out.emit("@256");
+        out.emit("D=A");
+        out.emit("@SP");
+        out.emit("M=D");
         writeCall("Sys.init", 0);
     }
 
     void writeLabel(const string& label) {
-        cout << "(" << label << ")" << "\n";
+        out.label(scoped(label));
     }
 
     void writeGoto(const string& label) {
-        cout << "@" << label << "\n";
-        cout << "0;JMP" << "\n";
+        out.emit("@", scoped(label));
+        out.emit("0;JMP");
     }
 
     void writeIf(const string& label) {
         // *(SP--)
-        cout << "@SP" << "\n";
-        cout << "AM=M-1" << "\n";
-        cout << "D=M" << "\n";
+        out.emit("@SP");
+        out.emit("AM=M-1");
+        out.emit("D=M");
 
         // jump if !=0
-        cout << "@" << label << "\n";
-        cout << "D;JNE" << "\n";
+        out.emit("@", scoped(label));
+        out.emit("D;JNE");
     }
 
     void writeFunction(const string& funcName, int numVars) {
-        cout << "// " << funcName << " " << numVars << "\n";
-        cout << "(" << funcName << ")" << "\n";
+        currentFunction = funcName;
+        out.comment(funcName, " ", numVars);
+        out.label(funcName);
+
+        // push 0 for each local
+        if (numVars == 1) {
+            out.emit("@SP");
+            out.emit("AM=M+1");
+            out.emit("A=A-1");
+            out.emit("M=0");
+        } else if (options.sizePrologue && numVars > 2) {
+            // 8 instructions for any count, 7 cycles a local
+            const string loop = labelPrefix + "PROLOGUE" + to_string(callCounter++);
+            out.emit("@", numVars);
+            out.emit("D=A");
+            out.label(loop);
+            out.emit("@SP");
+            out.emit("AM=M+1");
+            out.emit("A=A-1");
+            out.emit("M=0");
+            out.emit("D=D-1");
+            out.emit("@", loop);
+            out.emit("D;JGT");
+        } else if (numVars > 1) {
+            // 2 a local and SP written once
+            out.emit("@SP");
+            out.emit("A=M");
+            out.emit("M=0");
+            for (int i = 1; i < numVars; i++) {
+                out.emit("A=A+1");
+                out.emit("M=0");
+            }
+            out.emit("D=A+1");
+            out.emit("@SP");
+            out.emit("M=D");
+        }
     }
 
     void writeCall(const string& funcName, int numVars) {
-        cout << "// " << "call " << funcName << " " << numVars << "\n";
+        out.comment("call ", funcName, " ", numVars);
 
         // push returnAddress
-        const string returnAddress = "RET_ADDRESS_CALL" + to_string(callCounter++);
-        cout << "@" << returnAddress << "\n";
-        cout << "D=A" << "\n";
-        cout << "@SP" << "\n";
-        cout << "AM=M+1" << "\n";
-        cout << "A=A-1" << "\n";
-        cout << "M=D" << "\n";
+        const string returnAddress = labelPrefix + "RET_ADDRESS_CALL" + to_string(callCounter++);
+        if (Frame frame = frameOf(funcName); !frame.full()) {
+            writeFrameCall(frame, funcName, numVars, returnAddress);
+            return;
+        }
+        if (options.sharedCall) {
+            writeSharedCall(funcName, numVars, returnAddress);
+            return;
+        }
+        out.emit("@", returnAddress);
+        out.emit("D=A");
+        out.emit("@SP");
+        out.emit("AM=M+1");
+        out.emit("A=A-1");
+        out.emit("M=D");
 
         // push LCL
-        cout << "@LCL" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@SP" << "\n";
-        cout << "AM=M+1" << "\n";
-        cout << "A=A-1" << "\n";
-        cout << "M=D" << "\n";
+        out.emit("@LCL");
+        out.emit("D=M");
+        out.emit("@SP");
+        out.emit("AM=M+1");
+        out.emit("A=A-1");
+        out.emit("M=D");
 
         // push ARG
-        cout << "@ARG" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@SP" << "\n";
-        cout << "AM=M+1" << "\n";
-        cout << "A=A-1" << "\n";
-        cout << "M=D" << "\n";
+        out.emit("@ARG");
+        out.emit("D=M");
+        out.emit("@SP");
+        out.emit("AM=M+1");
+        out.emit("A=A-1");
+        out.emit("M=D");
 
         // push THIS
-        cout << "@THIS" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@SP" << "\n";
-        cout << "AM=M+1" << "\n";
-        cout << "A=A-1" << "\n";
-        cout << "M=D" << "\n";
+        out.emit("@THIS");
+        out.emit("D=M");
+        out.emit("@SP");
+        out.emit("AM=M+1");
+        out.emit("A=A-1");
+        out.emit("M=D");
 
         // push THAT
-        cout << "@THAT" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@SP" << "\n";
-        cout << "AM=M+1" << "\n";
-        cout << "A=A-1" << "\n";
-        cout << "M=D" << "\n";
+        out.emit("@THAT");
+        out.emit("D=M");
+        out.emit("@SP");
+        out.emit("AM=M+1");
+        out.emit("A=A-1");
+        out.emit("M=D");
 
         // repos ARG
-        cout << "@SP" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@5" << "\n";
-        cout << "D=D-A" << "\n";
-        cout << "@" << numVars << "\n";
-        cout << "D=D-A" << "\n";
-        cout << "@ARG" << "\n";
-        cout << "M=D" << "\n";
+        out.emit("@SP");
+        out.emit("D=M");
+        out.emit("@5");
+        out.emit("D=D-A");
+        out.emit("@", numVars);
+        out.emit("D=D-A");
+        out.emit("@ARG");
+        out.emit("M=D");
 
         // repos LCL
-        cout << "@SP" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@LCL" << "\n";
-        cout << "M=D" << "\n";
+        out.emit("@SP");
+        out.emit("D=M");
+        out.emit("@LCL");
+        out.emit("M=D");
 
         // goto funcName
-        cout << "@" << funcName << "\n";
-        cout << "0;JMP"<< "\n";
+        out.emit("@", funcName);
+        out.emit("0;JMP");
 
         // returnAddress
-        cout << "(" << returnAddress << ")" << "\n";
+        out.label(returnAddress);
+    }
+
+    // call funcName numArgs / return in the caller's frame: the callee
+    // returns straight to the caller's caller, so the stack doesn't grow
+    void writeTailCall(const string& funcName, int numArgs) {
+        out.comment("tail call ", funcName, " ", numArgs);
+        const string plainCall = labelPrefix + "TAIL_CALL" + to_string(callCounter++);
+        Frame frame = frameOf(funcName);
+        if (frame != frameOf(currentFunction)) {
+            writeCall(funcName, numArgs);
+            writeReturn();
+            return;
+        }
+
+        // the caller took numArgs too when LCL - ARG = numArgs + frame, the
+        // saved frame is then already where the callee's belongs. Without
+        // LCL both frames sit above the same, known number of arguments
+        if (frame.saveLcl) {
+            out.emit("@ARG");
+            out.emit("D=M");
+            out.emit("@LCL");
+            out.emit("D=M-D");
+            out.emit("@", numArgs + frame.size());
+            out.emit("D=D-A");
+            out.emit("@", plainCall);
+            out.emit("D;JNE");
+        }
+
+        // argument i = *(SP - numArgs + i), addressed directly for the
+        // usual few arguments, else pushed again from ARG on
+        if (numArgs > 6) {
+            // R13 = SP - numArgs, then SP = ARG
+            out.emit("@", numArgs);
+            out.emit("D=A");
+            out.emit("@SP");
+            out.emit("D=M-D");
+            out.emit("@R13");
+            out.emit("M=D");
+            out.emit("@ARG");
+            out.emit("D=M");
+            out.emit("@SP");
+            out.emit("M=D");
+            for (int i = 0; i < numArgs; i++) {
+                out.emit("@R13");
+                out.emit("AM=M+1");
+                out.emit("A=A-1");
+                out.emit("D=M");
+                out.emit("@SP");
+                out.emit("AM=M+1");
+                out.emit("A=A-1");
+                out.emit("M=D");
+            }
+        } else {
+            for (int i = 0; i < numArgs; i++) {
+                out.emit("@SP");
+                if (numArgs - i == 1) {
+                    out.emit("A=M-1");
+                } else {
+                    out.emit("D=M");
+                    out.emit("@", numArgs - i);
+                    out.emit("A=D-A");
+                }
+                out.emit("D=M");
+                out.emit("@ARG");
+                out.emit(i == 0 ? "A=M" : "A=M+1");
+                for (int j = 1; j < i; j++) {
+                    out.emit("A=A+1");
+                }
+                out.emit("M=D");
+            }
+        }
+
+        // SP = LCL, the end of the frame
+        if (frame.saveLcl) {
+            out.emit("@LCL");
+            out.emit("D=M");
+        } else {
+            out.emit("@ARG");
+            out.emit("D=M");
+            out.emit("@", numArgs + frame.size());
+            out.emit("D=D+A");
+        }
+        out.emit("@SP");
+        out.emit("M=D");
+        out.emit("@", funcName);
+        out.emit("0;JMP");
+        if (!frame.saveLcl) {
+            return;
+        }
+
+        // a caller with another argument count makes a plain call, moving
+        // its frame would cost more than the call saves
+        out.label(plainCall);
+        writeCall(funcName, numArgs);
+        writeReturn();
     }
 
     void writeReturn() {
-        cout << "// " << "return" << "\n";
-
-        // endFrame = LCL
-        cout << "@LCL" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@END_FRAME" << "\n";
-        cout << "M=D" << "\n";
-
-        // retAddr = *(endFrame - 5)
-        cout << "@5" << "\n";
-        cout << "D=A" << "\n";
-        cout << "@END_FRAME" << "\n";
-        cout << "A=M-D" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@RET_ADDR" << "\n";
-        cout << "M=D" << "\n";
-
-        // *ARG = pop()
-        cout << "@SP" << "\n";
-        cout << "AM=M-1" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@ARG" << "\n";
-        cout << "A=M" << "\n";
-        cout << "M=D" << "\n";
-
-        // SP = ARG + 1
-        cout << "@ARG" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@SP" << "\n";
-        cout << "M=D+1" << "\n";
-
-        // THAT = *(endFrame - 1)
-        cout << "@1" << "\n";
-        cout << "D=A" << "\n";
-        cout << "@END_FRAME" << "\n";
-        cout << "A=M-D" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@THAT" << "\n";
-        cout << "M=D" << "\n";
-
-        // THIS = *(endFrame - 2)
-        cout << "@2" << "\n";
-        cout << "D=A" << "\n";
-        cout << "@END_FRAME" << "\n";
-        cout << "A=M-D" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@THIS" << "\n";
-        cout << "M=D" << "\n";
-
-        // ARG = *(endFrame - 3)
-        cout << "@3" << "\n";
-        cout << "D=A" << "\n";
-        cout << "@END_FRAME" << "\n";
-        cout << "A=M-D" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@ARG" << "\n";
-        cout << "M=D" << "\n";
-
-        // LCL = *(endFrame - 4)
-        cout << "@4" << "\n";
-        cout << "D=A" << "\n";
-        cout << "@END_FRAME" << "\n";
-        cout << "A=M-D" << "\n";
-        cout << "D=M" << "\n";
-        cout << "@LCL" << "\n";
-        cout << "M=D" << "\n";
-
-        // goto retAddr
-        cout << "@RET_ADDR" << "\n";
-        cout << "A=M" << "\n";
-        cout << "0;JMP" << "\n";
+        out.comment("return");
+        if (Frame frame = frameOf(currentFunction); !frame.full()) {
+            writeFrameReturn(frame);
+        } else if (options.sharedCall) {
+            size_t before = out.instructionCount();
+            out.emit("@VM$RETURN");
+            out.emit("0;JMP");
+            returnSiteInstructions += out.instructionCount() - before;
+            sharedReturns++;
+        } else {
+            writeReturnBody();
+        }
+    }
+
+    void writeCommand(const Command& c) {
+        switch (c.type) {
+        case C_ARITHMETIC:
+            writeArithmetic(c.op);
+            break;
+        case C_PUSH:
+        case C_POP:
+            writePushPop(c.type, c.segment, c.arg2, c.name);
+            break;
+        case C_LABEL:
+            writeLabel(c.name);
+            break;
+        case C_GOTO:
+            writeGoto(c.name);
+            break;
+        case C_IF:
+            writeIf(c.name);
+            break;
+        case C_FUNCTION:
+            writeFunction(c.name, c.arg2);
+            break;
+        case C_CALL:
+            writeCall(c.name, c.arg2);
+            break;
+        case C_RETURN:
+            writeReturn();
+            break;
+        case C_MOVE:
+            writeMove(c);
+            break;
+        case C_UPDATE:
+            writeUpdate(c);
+            break;
+        case C_BRANCH:
+            writeBranch(c);
+            break;
+        case C_ARRAY_STORE:
+            writeArrayStore();
+            break;
+        case C_TAIL_CALL:
+            writeTailCall(c.name, c.arg2);
+            break;
+        }
+    }
+
+    // one file's commands, peephole optimized first with -O
+    void writeCommands(vector<Command>& commands) {
+        if (options.optimize) {
+            PeepholeOptimizer(commands, peephole).run();
+        }
+        if (options.tailCall) {
+            tailCalls += fuseTailCalls(commands);
+        }
+        for (const Command& c : commands) {
+            if (options.cacheTos) {
+                writeCachedCommand(c);
+            } else if (options.batchSp) {
+                writeBatchedCommand(c);
+            } else {
+                writeCommand(c);
+            }
+        }
+        // the next file may start with anything
+        spill();
+        commit();
+    }
+
+    // code of a file translated by another writer, whose bookkeeping is
+    // taken over for finish()
+    void append(const CodeWriter& file) {
+        out.write(file.out);
+        sharedCalls += file.sharedCalls;
+        sharedReturns += file.sharedReturns;
+        callSiteInstructions += file.callSiteInstructions;
+        returnSiteInstructions += file.returnSiteInstructions;
+        for (int i = 0; i < 3; i++) {
+            compareSites[i] += file.compareSites[i];
+        }
+        compareSiteInstructions += file.compareSiteInstructions;
+        peephole.moves += file.peephole.moves;
+        peephole.updates += file.peephole.updates;
+        peephole.branches += file.peephole.branches;
+        peephole.arrayStores += file.peephole.arrayStores;
+        peephole.constants += file.peephole.constants;
+        peephole.dead += file.peephole.dead;
+        tailCalls += file.tailCalls;
+    }
+
+    // shared routines, after all translated code
+    void finish() {
+        bool anyCompare = compareSites[0] || compareSites[1] || compareSites[2];
+        if (sharedCalls > 0 || sharedReturns > 0 || anyCompare) {
+            // a program without Sys.init would run off its end into the routines
+            out.label("VM$END");
+            out.emit("@VM$END");
+            out.emit("0;JMP");
+        }
+        if (sharedCalls > 0) {
+            writeCallRoutine();
+        }
+        if (sharedReturns > 0) {
+            out.comment("shared return");
+            out.label("VM$RETURN");
+            writeReturnBody();
+        }
+        for (int i = 0; i < 3; i++) {
+            if (compareSites[i] > 0) {
+                writeCompareRoutine(compareOps[i]);
+            }
+        }
+        if (options.sharedCall) {
+            reportSharedCall();
+        }
+        if (options.sharedCompare) {
+            reportSharedCompare();
+        }
+        if (options.optimize) {
+            reportPeephole();
+        }
+        if (options.tailCall) {
+            cerr << "tail call: " << tailCalls << " sites\n";
+        }
     }
 };
 
-// helper
 void processSingleFile(const string& path, CodeWriter& cw) {
-    // Some crappy filename parsing
-    size_t lastDot = path.find_last_of(".");
-    size_t lastSlash = path.find_last_of("/");
-    size_t start = 0;
-    if (lastSlash == -1) {
-        start = 0;
-    } else {
-        start = lastSlash+1;
+    SourceFile source = readSourceFile(path);
+    cw.setFileName(source.name);
+    cw.writeCommands(source.commands);
+}
+
+// Hack instructions the files translate to, routines and Sys.init call
+// not included
+size_t romSize(const vector<SourceFile>& sources, const TranslatorOptions& options) {
+    OutputSink scratch;
+    CodeWriter cw(scratch, options);
+    for (SourceFile source : sources) {
+        cw.setFileName(source.name);
+        cw.writeCommands(source.commands);
     }
+    return scratch.instructionCount();
+}
 
-    // Phase 1 Parsing
-    std::ifstream file(path);
-    Parser p = Parser(file);
-    string filename = path.substr(start, lastDot - start);
-
-    cw.setFileName(filename);
-    while (p.hasMoreCommands()) {
-        if (p.commandType() == C_ARITHMETIC) {
-            cw.writeArithmetic(p.arg1());
-        } else if (p.commandType() == C_PUSH || p.commandType() == C_POP) {
-            cw.writePushPop(p.commandType(), p.arg1(), p.arg2());
-        } else if (p.commandType() == C_LABEL) {
-            cw.writeLabel(p.arg1());
-        } else if (p.commandType() == C_IF) {
-            cw.writeIf(p.arg1());
-        } else if (p.commandType() == C_GOTO) {
-            cw.writeGoto(p.arg1());
-        } else if (p.commandType() == C_FUNCTION) {
-            cw.writeFunction(p.arg1(), p.arg2());
-        } else if (p.commandType() == C_CALL) {
-            cw.writeCall(p.arg1(), p.arg2());
-        } else if (p.commandType() == C_RETURN) {
-            cw.writeReturn();
-        }
-        p.advance();
+void inlineCalls(vector<SourceFile>& sources, const TranslatorOptions& options) {
+    size_t before = romSize(sources, options);
+    InlineStats stats;
+    Inliner(sources, "Sys.init", options.inlineSize, stats).run();
+    size_t after = romSize(sources, options);
+    cerr << "inline: " << stats.sites << " call sites of " << stats.functions << " functions\n"
+         << "  ROM: " << after << " instructions (before: " << before << ", "
+         << (after >= before ? "+" : "") << (long long)after - (long long)before << ")\n";
+}
+
+// inlining and dead function removal work on the commands, for any target
+void transformProgram(vector<SourceFile>& sources, const TranslatorOptions& options) {
+    if (options.inlineSize > 0) {
+        inlineCalls(sources, options);
+    }
+
+    if (options.dce) {
+        size_t total = CallGraph(sources).size();
+        size_t removed = removeDeadFunctions(sources, "Sys.init");
+        cerr << "dce: " << total - removed << " of " << total
+             << " functions reachable from Sys.init\n";
     }
 }
 
-void processDirectory(const string& path, CodeWriter& cw) {
-    string ext(".vm");
+void processDirectory(const string& path, CodeWriter& cw, const TranslatorOptions& options) {
+    vector<SourceFile> sources = readDirectory(path);
+    transformProgram(sources, options);
+
+    shared_ptr<const unordered_map<string, Frame>> frames;
+    if (options.elideFrames) {
+        FrameStats stats;
+        frames = make_shared<const unordered_map<string, Frame>>(analyzeFrames(sources, "Sys.init", stats));
+        cerr << "frames: " << stats.functions - frames->size() << " of " << stats.functions << " functions standard, "
+             << stats.withoutLcl << " without LCL, " << stats.withoutThis << " without THIS, "
+             << stats.withoutThat << " without THAT\n";
+        cw.setFrames(frames);
+    }
+
+    // every file gets its own writer and buffer, so the output only
+    // depends on the sorted file order and not on the thread count
+    struct FileJob {
+        OutputSink code;
+        unique_ptr<CodeWriter> writer;
+        exception_ptr error;
+    };
+    vector<FileJob> jobs(sources.size());
+    atomic<size_t> next = 0;
+    auto work = [&]() {
+        for (size_t i = next++; i < jobs.size(); i = next++) {
+            try {
+                jobs[i].writer = make_unique<CodeWriter>(jobs[i].code, options);
+                jobs[i].writer->setFileName(sources[i].name);
+                jobs[i].writer->setFrames(frames);
+                jobs[i].writer->writeCommands(sources[i].commands);
+            } catch (...) {
+                jobs[i].error = current_exception();
+            }
+        }
+    };
+    vector<thread> workers;
+    for (int t = 1; t < options.threads && t < (int) jobs.size(); t++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (thread& t : workers) {
+        t.join();
+    }
+
     cw.writeInit();
-    for (auto &p : filesystem::recursive_directory_iterator(path)) {
-        if (p.path().extension() == ext) {
-            processSingleFile(p.path().string(), cw);
+    for (FileJob& job : jobs) {
+        if (job.error) {
+            rethrow_exception(job.error);
         }
+        cw.append(*job.writer);
     }
 }
 
+// a directory starts with the bootstrap call of Sys.init, a file at its
+// first command
+void writeCppProgram(const string& path, OutputSink& out, const TranslatorOptions& options) {
+    error_code ec;
+    bool directory = filesystem::is_directory(path, ec);
+    vector<SourceFile> sources = directory ? readDirectory(path) : vector<SourceFile>{readSourceFile(path)};
+    if (directory) {
+        transformProgram(sources, options);
+    }
+    CppStats stats;
+    CppWriter(out, stats).write(sources, directory);
+    cerr << "cpp: " << stats.functions << " functions, " << stats.undefined << " called but not defined\n";
+}
+
 // main
 int main(int argc, char* argv[]) {
-    if (argc <= 1) {
-        cout << "./a.out <filename>\n" << "./a.out <directory>\n";
+    string path, outputPath;
+    TranslatorOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "--shared-call") {
+            options.sharedCall = true;
+        } else if (arg == "--shared-compare") {
+            options.sharedCompare = true;
+        } else if (arg == "-O") {
+            options.optimize = true;
+        } else if (arg == "--cache-tos") {
+            options.cacheTos = true;
+        } else if (arg == "--batch-sp") {
+            options.batchSp = true;
+        } else if (arg == "--dce") {
+            options.dce = true;
+        } else if (arg == "--tail-call") {
+            options.tailCall = true;
+        } else if (arg.starts_with("--prologue=")) {
+            options.sizePrologue = arg == "--prologue=size";
+        } else if (arg.starts_with("--target=")) {
+            options.cppTarget = arg == "--target=cpp";
+        } else if (arg == "--elide-frames") {
+            options.elideFrames = true;
+        } else if (arg == "--inline") {
+            options.inlineSize = 16;
+        } else if (arg.starts_with("--inline=")) {
+            options.inlineSize = max(0, atoi(arg.c_str() + 9));
+        } else if (arg == "-j" && i + 1 < argc) {
+            options.threads = max(1, atoi(argv[++i]));
+        } else if (arg == "-o" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else {
+            path = arg;
+        }
+    }
+
+    if (path.empty()) {
+        cout << "./a.out [options] [-o <output.asm>] <filename.vm | filename.vmb>\n"
+             << "./a.out [options] [-o <output.asm>] <directory>\n"
+             << "  -O                fuse common command sequences, drop unreachable commands\n"
+             << "  --cache-tos       keep the top of the stack in D within straight-line code\n"
+             << "  --batch-sp        one SP update per basic block (ignored with --cache-tos)\n"
+             << "  --dce             only emit functions reachable from Sys.init (directories)\n"
+             << "  --inline[=<n>]    inline leaf functions of up to n commands, 16 by default\n"
+             << "                    (directories)\n"
+             << "  --prologue=<p>    speed: unrolled local zeroing (default), size: a loop\n"
+             << "  --elide-frames    save only the pointers each callee changes (directories)\n"
+             << "  --tail-call       call f n / return jumps to f in the caller's frame\n"
+             << "  --target=<t>      hack: Hack assembly (default), cpp: a C++17 program that\n"
+             << "                    runs the VM code natively; -O and the frame and stack\n"
+             << "                    options only apply to hack. The program takes --set,\n"
+             << "                    --print and --steps like the VM interpreter\n"
+             << "  -j <n>            translate the files of a directory on n threads\n"
+             << "  --shared-call     one shared call and return routine instead of inline frames\n"
+             << "  --shared-compare  one shared routine per eq/gt/lt instead of inline compares\n";
         return 0;
     }
 
     error_code ec;
-    const string path(argv[1]);
-    CodeWriter cw;
+    unique_ptr<OutputSink> out = outputPath.empty()
+        ? make_unique<OutputSink>(STDOUT_FILENO)
+        : make_unique<OutputSink>(outputPath);
+    if (options.cppTarget) {
+        writeCppProgram(path, *out, options);
+        return 0;
+    }
+    CodeWriter cw(*out, options);
     if (filesystem::is_directory(path, ec)) {
-        processDirectory(argv[1], cw);
+        processDirectory(path, cw, options);
     } else {
-        processSingleFile(argv[1], cw);
+        processSingleFile(path, cw);
     }
+    cw.finish();
 }
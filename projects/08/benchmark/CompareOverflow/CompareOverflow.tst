@@ -0,0 +1,15 @@
+// Run with vm_bench, e.g. --flags "-O --shared-compare". The default
+// compare subtracts too, so the unflagged run fails this test.
+
+load CompareOverflow.asm,
+output-file CompareOverflow.out,
+compare-to CompareOverflow.cmp,
+output-list RAM[16]%D1.6.1 RAM[17]%D1.6.1 RAM[18]%D1.6.1 RAM[19]%D1.6.1;
+
+set RAM[0] 256,
+
+repeat 400 {
+  ticktock;
+}
+
+output;
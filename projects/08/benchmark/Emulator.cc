@@ -0,0 +1,105 @@
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+using namespace std;
+
+// Emulator
+// Hack CPU over a .hack program, one instruction per cycle. The program
+// halts when it leaves ROM or enters the usual "(END) @END 0;JMP" loop.
+class Emulator {
+private:
+  vector<uint16_t> rom;
+  array<int16_t, 32768> ram{};
+  uint16_t pc = 0;
+  int16_t a = 0;
+  int16_t d = 0;
+  long cycleCount = 0;
+  bool stopped = false;
+
+  int16_t compute(uint16_t comp, int16_t y) const {
+      int16_t x = d;
+      if (comp & 0b100000) x = 0;
+      if (comp & 0b010000) x = ~x;
+      if (comp & 0b001000) y = 0;
+      if (comp & 0b000100) y = ~y;
+      int16_t out = (comp & 0b000010) ? int16_t(x + y) : int16_t(x & y);
+      if (comp & 0b000001) out = ~out;
+      return out;
+  }
+
+  void step() {
+      if (pc >= rom.size()) {
+          stopped = true;
+          return;
+      }
+      uint16_t instruction = rom[pc];
+      cycleCount++;
+      if (!(instruction & 0x8000)) {
+          a = instruction;
+          pc++;
+          return;
+      }
+
+      uint16_t address = uint16_t(a) & 0x7FFF;
+      int16_t y = (instruction & 0x1000) ? ram[address] : a;
+      int16_t out = compute((instruction >> 6) & 0b111111, y);
+      uint16_t dest = (instruction >> 3) & 0b111;
+      uint16_t jump = instruction & 0b111;
+
+      if (dest & 0b001) ram[address] = out;
+      if (dest & 0b100) a = out;
+      if (dest & 0b010) d = out;
+
+      bool taken = ((jump & 0b100) && out < 0)
+          || ((jump & 0b010) && out == 0)
+          || ((jump & 0b001) && out > 0);
+      if (!taken) {
+          pc++;
+          return;
+      }
+      // @self / 0;JMP
+      if (jump == 0b111 && dest == 0 && pc > 0 && uint16_t(a) == pc - 1 && rom[pc - 1] == pc - 1) {
+          stopped = true;
+      }
+      pc = uint16_t(a);
+  }
+
+public:
+    Emulator(const string& hackPath) {
+        ifstream file(hackPath);
+        if (!file.is_open()) {
+            throw invalid_argument("file not found: " + hackPath);
+        }
+        for (string line; getline(file, line); ) {
+            if (line.size() >= 16) {
+                rom.push_back(stoi(line.substr(0, 16), nullptr, 2));
+            }
+        }
+    }
+
+    // runs until the program halts or maxCycles have passed
+    void run(long maxCycles) {
+        while (!stopped && cycleCount < maxCycles) {
+            step();
+        }
+    }
+
+    int16_t& operator[](size_t address) {
+        return ram[address];
+    }
+
+    bool halted() const {
+        return stopped;
+    }
+
+    long cycles() const {
+        return cycleCount;
+    }
+
+    size_t romSize() const {
+        return rom.size();
+    }
+};
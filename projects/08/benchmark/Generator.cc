@@ -0,0 +1,67 @@
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Generator
+// Synthetic multi-file VM project shaped like compiled Jack: every file is
+// a class of functions made of pushes, pops, arithmetic, loops and calls,
+// plus a Sys.vm whose Sys.init calls into each class. Output is
+// deterministic for a given seed.
+struct GeneratorConfig {
+    size_t files = 64;
+    size_t functions = 20;  // per file
+    size_t commands = 100;  // per function
+    unsigned seed = 1;
+};
+
+void generateVm(const filesystem::path& dir, const GeneratorConfig& config) {
+    static const vector<string> segments = {"local", "argument", "this", "that", "static", "temp"};
+    static const vector<string> operators = {"add", "sub", "and", "or", "eq", "gt", "lt", "neg", "not"};
+
+    mt19937 rng(config.seed);
+    uniform_int_distribution<int> percent(0, 99);
+    uniform_int_distribution<size_t> anySegment(0, segments.size() - 1);
+    uniform_int_distribution<size_t> anyOperator(0, operators.size() - 1);
+    uniform_int_distribution<size_t> anyFile(0, config.files - 1);
+    uniform_int_distribution<size_t> anyFunction(0, config.functions - 1);
+    uniform_int_distribution<int> anyIndex(0, 7);
+    uniform_int_distribution<int> anyConstant(0, 32767);
+
+    filesystem::create_directories(dir);
+    for (size_t f = 0; f < config.files; f++) {
+        string name = "Class" + to_string(f);
+        ofstream out(dir / (name + ".vm"));
+        for (size_t fn = 0; fn < config.functions; fn++) {
+            out << "function " << name << ".f" << fn << " 8\n";
+            for (size_t i = 0; i < config.commands; i++) {
+                int r = percent(rng);
+                if (r < 35) {
+                    out << "push " << segments[anySegment(rng)] << " " << anyIndex(rng) << "\n";
+                } else if (r < 45) {
+                    out << "push constant " << anyConstant(rng) << "\n";
+                } else if (r < 65) {
+                    out << "pop " << segments[anySegment(rng)] << " " << anyIndex(rng) << "\n";
+                } else if (r < 85) {
+                    out << operators[anyOperator(rng)] << "\n";
+                } else if (r < 90) {
+                    out << "label L" << i << "\n";
+                } else if (r < 95) {
+                    out << "if-goto L" << i << "\nlabel L" << i << "\n";
+                } else {
+                    out << "call Class" << anyFile(rng) << ".f" << anyFunction(rng) << " 2\n";
+                }
+            }
+            out << "push constant 0\nreturn\n";
+        }
+    }
+
+    ofstream sys(dir / "Sys.vm");
+    sys << "function Sys.init 0\n";
+    for (size_t f = 0; f < config.files; f++) {
+        sys << "call Class" << f << ".f0 0\npop temp 0\n";
+    }
+    sys << "label HALT\ngoto HALT\n";
+}
@@ -0,0 +1,73 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include "../../06/benchmark/Run.cc"
+#include "./Generator.cc"
+using namespace std;
+
+// Runs the VM translator with -j 1..N on one project directory, checks
+// that every thread count produces the same output as -j 1 and prints wall
+// time and speedup. Unless given a directory, a synthetic many-file
+// project is generated first.
+
+string readFile(const string& path) {
+    ifstream file(path, ios::binary);
+    return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+int main(int argc, char* argv[]) {
+    if (argc <= 1) {
+        cout << "./a.out <translator> [directory | number of files] [max threads] [repeats] [flags...]\n"
+             << "  a number generates a synthetic project with that many files (default 64)\n";
+        return 0;
+    }
+    string translator(argv[1]);
+    string input = argc > 2 ? argv[2] : "";
+    int maxThreads = argc > 3 ? atoi(argv[3]) : max(1u, thread::hardware_concurrency());
+    int repeats = argc > 4 ? atoi(argv[4]) : 5;
+    vector<string> flags(argv + min(argc, 5), argv + argc);
+
+    string generated;
+    if (!filesystem::is_directory(input)) {
+        GeneratorConfig config;
+        if (!input.empty()) {
+            config.files = max(1, atoi(input.c_str()));
+        }
+        generated = "/tmp/scaling_bench." + to_string(getpid());
+        generateVm(generated, config);
+        input = generated;
+        cout << "synthetic project: " << config.files << " files\n";
+    }
+
+    string reference;
+    double base = 0;
+    cout << "threads  seconds  speedup\n";
+    for (int j = 1; j <= maxThreads; j++) {
+        string out = "/tmp/scaling_bench." + to_string(getpid()) + ".asm";
+        vector<string> args = {translator, "-j", to_string(j), "-o", out};
+        args.insert(args.end(), flags.begin(), flags.end());
+        args.push_back(input);
+        RunResult r = bestRun(args, repeats);
+        string output = readFile(out);
+        remove(out.c_str());
+        if (r.status != 0) {
+            cout << "translator failed with -j " << j << "\n";
+            return 1;
+        }
+        if (j == 1) {
+            reference = output;
+            base = r.seconds;
+        } else if (output != reference) {
+            cout << "output with -j " << j << " differs from -j 1\n";
+            return 1;
+        }
+        cout << j << "        " << r.seconds << "  " << base / r.seconds << "\n";
+    }
+
+    if (!generated.empty()) {
+        filesystem::remove_all(generated);
+    }
+}
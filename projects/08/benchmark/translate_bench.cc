@@ -0,0 +1,129 @@
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../06/benchmark/Run.cc"
+#include "../../06/assembler/MappedFile.cc"
+#include "../VMTranslator/Parser.cc"
+#include "./Generator.cc"
+using namespace std;
+
+// Translation throughput in VM commands per second for one or more
+// translator builds, e.g. before and after a parser change, on the same
+// input. Unless given a directory, a synthetic project is generated.
+// With -b the project is also converted to .vmb and timed again.
+
+// non-blank lines that aren't only a comment
+size_t countCommands(const string& dir) {
+    size_t count = 0;
+    for (auto& p : filesystem::recursive_directory_iterator(dir)) {
+        if (p.path().extension() != ".vm") {
+            continue;
+        }
+        ifstream file(p.path());
+        string line;
+        while (getline(file, line)) {
+            size_t start = line.find_first_not_of(" \t\r");
+            if (start != string::npos && line.compare(start, 2, "//") != 0) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// dir with every .vm file of from as .vmb
+void convertToBytecode(const string& from, const string& dir) {
+    filesystem::create_directories(dir);
+    for (auto& p : filesystem::recursive_directory_iterator(from)) {
+        if (p.path().extension() != ".vm") {
+            continue;
+        }
+        MappedFile file(p.path().string());
+        vector<Command> commands;
+        for (Parser parser(file.view(), p.path().string()); parser.hasMoreCommands(); parser.advance()) {
+            commands.push_back(parser.command());
+        }
+        filesystem::path out = dir / p.path().filename();
+        ofstream(out.replace_extension(".vmb"), ios::binary) << encodeBytecode(commands);
+    }
+}
+
+// best time per translator, empty when one fails
+vector<double> timeTranslators(const vector<string>& translators, const string& input, int repeats) {
+    vector<double> seconds;
+    for (const string& translator : translators) {
+        RunResult r = bestRun({translator, "-o", "/dev/null", input}, repeats);
+        if (r.status != 0) {
+            cout << translator << " failed on " << input << "\n";
+            return {};
+        }
+        seconds.push_back(r.seconds);
+    }
+    return seconds;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc <= 1) {
+        cout << "./a.out [-i directory | number of files] [-r repeats] [-b] <translator>...\n"
+             << "  the first translator is the baseline; default is a synthetic 256 file project\n"
+             << "  -b  also time the project converted to .vmb (translators that read .vmb only)\n";
+        return 0;
+    }
+    string input = "256";
+    int repeats = 5;
+    bool bytecode = false;
+    vector<string> translators;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "-i" && i + 1 < argc) {
+            input = argv[++i];
+        } else if (arg == "-r" && i + 1 < argc) {
+            repeats = max(1, atoi(argv[++i]));
+        } else if (arg == "-b") {
+            bytecode = true;
+        } else {
+            translators.push_back(arg);
+        }
+    }
+
+    string generated;
+    if (!filesystem::is_directory(input)) {
+        GeneratorConfig config;
+        config.files = max(1, atoi(input.c_str()));
+        generated = "/tmp/translate_bench." + to_string(getpid());
+        generateVm(generated, config);
+        input = generated;
+    }
+    size_t commands = countCommands(input);
+    cout << input << ": " << commands << " commands\n";
+
+    vector<pair<string, string>> inputs = {{".vm", input}};
+    string converted;
+    if (bytecode) {
+        converted = "/tmp/translate_bench." + to_string(getpid()) + ".vmb";
+        convertToBytecode(input, converted);
+        inputs.push_back({".vmb", converted});
+    }
+
+    double base = 0;
+    for (auto& [form, dir] : inputs) {
+        vector<double> seconds = timeTranslators(translators, dir, repeats);
+        if (seconds.empty()) {
+            return 1;
+        }
+        for (size_t t = 0; t < translators.size(); t++) {
+            base = base == 0 ? seconds[t] : base;
+            cout << translators[t] << " " << form << ": " << seconds[t] << " s, "
+                 << commands / seconds[t] << " commands/sec (" << base / seconds[t] << "x)\n";
+        }
+    }
+
+    if (!generated.empty()) {
+        filesystem::remove_all(generated);
+    }
+    if (!converted.empty()) {
+        filesystem::remove_all(converted);
+    }
+}
@@ -0,0 +1,187 @@
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../../06/benchmark/Run.cc"
+#include "./Emulator.cc"
+using namespace std;
+
+// Translates VM test programs with and without a set of translator flags,
+// runs both on the Hack emulator and compares executed cycles and ROM.
+// Directories with a .tst/.cmp pair are checked against the expected RAM,
+// directories without one (e.g. compiled Jack programs) only report ROM.
+
+struct TestScript {
+    vector<pair<int, int>> setup; // set RAM[a] v
+    vector<int> outputs;          // output-list RAM[a]
+    vector<int> expected;         // value rows of the .cmp
+};
+
+string readFile(const string& path) {
+    ifstream file(path);
+    stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+TestScript readTestScript(const string& tstPath, const string& cmpPath) {
+    TestScript script;
+    string tst = regex_replace(readFile(tstPath), regex("//[^\n]*"), "");
+    regex set(R"(set RAM\[(\d+)\]\s+(-?\d+))");
+    for (sregex_iterator it(tst.begin(), tst.end(), set), end; it != end; ++it) {
+        script.setup.push_back({stoi((*it)[1]), stoi((*it)[2])});
+    }
+    // every output-list is assumed to be printed once
+    regex list(R"(output-list([^;]*);)"), ram(R"(RAM\[(\d+)\])");
+    for (sregex_iterator it(tst.begin(), tst.end(), list), end; it != end; ++it) {
+        string cells = (*it)[1];
+        for (sregex_iterator cell(cells.begin(), cells.end(), ram); cell != end; ++cell) {
+            script.outputs.push_back(stoi((*cell)[1]));
+        }
+    }
+
+    istringstream cmp(readFile(cmpPath));
+    for (string line; getline(cmp, line); ) {
+        if (line.find("RAM") != string::npos) {
+            continue;
+        }
+        regex number(R"(-?\d+)");
+        for (sregex_iterator it(line.begin(), line.end(), number), end; it != end; ++it) {
+            script.expected.push_back(stoi(it->str()));
+        }
+    }
+    return script;
+}
+
+struct Measurement {
+    bool built = false;
+    size_t rom = 0;
+    long cycles = 0;
+    bool halted = false;
+    bool passed = false;
+};
+
+Measurement measure(const string& translator, const string& assembler, const vector<string>& flags,
+                    const string& input, const TestScript* script) {
+    Measurement m;
+    string base = "/tmp/vm_bench." + to_string(getpid());
+    vector<string> translate = {translator};
+    translate.insert(translate.end(), flags.begin(), flags.end());
+    translate.insert(translate.end(), {"-o", base + ".asm", input});
+    if (runCommand(translate).status != 0
+        || runCommand({assembler, "-o", base + ".hack", base + ".asm"}).status != 0) {
+        return m;
+    }
+
+    Emulator hack(base + ".hack");
+    remove((base + ".asm").c_str());
+    remove((base + ".hack").c_str());
+    m.built = true;
+    m.rom = hack.romSize();
+    if (!script) {
+        return m;
+    }
+
+    for (auto [address, value] : script->setup) {
+        hack[address] = value;
+    }
+    hack.run(100000000);
+    m.cycles = hack.cycles();
+    m.halted = hack.halted();
+    vector<int> got;
+    for (int address : script->outputs) {
+        got.push_back(hack[address]);
+    }
+    m.passed = got == script->expected;
+    return m;
+}
+
+vector<string> splitWords(const string& s) {
+    vector<string> words;
+    istringstream in(s);
+    for (string w; in >> w; ) {
+        words.push_back(w);
+    }
+    return words;
+}
+
+string percent(double before, double after) {
+    ostringstream s;
+    s.precision(1);
+    s << fixed << (before ? 100.0 * (after - before) / before : 0) << "%";
+    return s.str();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc <= 3) {
+        cout << "./a.out <translator> <assembler> [--flags \"flags\"] <test dir>...\n"
+             << "  e.g. ./a.out ./vm ./asm --flags -O ../07/*/* ../08/*/*\n";
+        return 0;
+    }
+
+    string translator(argv[1]), assembler(argv[2]);
+    vector<string> flags = {"-O"};
+    vector<string> dirs;
+    for (int i = 3; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "--flags" && i + 1 < argc) {
+            flags = splitWords(argv[++i]);
+        } else if (filesystem::is_directory(arg)) {
+            dirs.push_back(arg);
+        }
+    }
+
+    int failures = 0;
+    long totalBefore = 0, totalAfter = 0;
+    cout << "test                  rom    flagged  cycles   flagged  change   result\n";
+    for (const string& dir : dirs) {
+        filesystem::path path(dir);
+        string name = path.filename().string();
+        if (name.empty()) {
+            name = path.parent_path().filename().string();
+        }
+        string stem = (path / name).string();
+        // programs with a Sys.vm get the bootstrap, single files do not
+        string input = filesystem::exists(path / "Sys.vm") ? dir : stem + ".vm";
+        if (!filesystem::exists(input)) {
+            continue;
+        }
+
+        TestScript script;
+        bool hasTest = filesystem::exists(stem + ".tst") && filesystem::exists(stem + ".cmp");
+        if (hasTest) {
+            script = readTestScript(stem + ".tst", stem + ".cmp");
+        }
+        Measurement before = measure(translator, assembler, {}, input, hasTest ? &script : nullptr);
+        Measurement after = measure(translator, assembler, flags, input, hasTest ? &script : nullptr);
+
+        string result = "rom only";
+        if (!before.built || !after.built) {
+            result = "build failed";
+        } else if (hasTest) {
+            result = after.passed ? "PASS" : before.passed ? "FAIL" : "FAIL (also unflagged)";
+            if (!after.halted) {
+                result += ", no halt";
+            }
+        }
+        failures += hasTest && before.passed && !after.passed;
+
+        cout << left << setw(20) << name << "  " << setw(6) << before.rom << " " << setw(8) << after.rom;
+        if (hasTest) {
+            cout << " " << setw(8) << before.cycles << " " << setw(8) << after.cycles
+                 << " " << setw(8) << percent(before.cycles, after.cycles);
+            totalBefore += before.cycles;
+            totalAfter += after.cycles;
+        } else {
+            cout << " " << setw(8) << "-" << " " << setw(8) << "-" << " " << setw(8) << percent(before.rom, after.rom);
+        }
+        cout << " " << result << "\n";
+    }
+    cout << "total cycles: " << totalBefore << " -> " << totalAfter
+         << " (" << percent(totalBefore, totalAfter) << ")\n";
+    return failures ? 1 : 0;
+}
@@ -61,7 +61,13 @@ private:
   }
 
   void writeOp(char op) {
-      vw.writeArithmetic(ops[op]);
+      if (op == '*') {
+          vw.writeCall("Math.multiply", 2);
+      } else if (op == '/') {
+          vw.writeCall("Math.divide", 2);
+      } else {
+          vw.writeArithmetic(ops[op]);
+      }
   }
 
   void writeUOp(char op) {
@@ -76,7 +82,8 @@ public:
   CompilationEngine(
     ifstream& in,
     ofstream& out,
-    string fileName): jt(in), vw(out), className(fileName), label(0) {}
+    string fileName,
+    bool bytecode = false): jt(in), vw(out, bytecode), className(fileName), label(0) {}
 
   void compileClass() {
       assert(jt.hasMoreTokens());
@@ -102,6 +109,7 @@ public:
       eat(SYMBOL);
 
       vw.writeComment("class " + className) ;
+      vw.close();
   }
 
   /**
@@ -1,13 +1,15 @@
+#include <cassert>
 #include <string>
 #include <iostream>
 #include <filesystem>
+#include "../../08/VMTranslator/Bytecode.cc"
 #include "./SymbolTable.cc"
 #include "./JackTokenizer.cc"
 #include "./VMWriter.cc"
 #include "./CompilationEngine.cc"
 using namespace std;
 
-void processSingleFile(const string& path) {
+void processSingleFile(const string& path, bool bytecode) {
     // Some crappy filename parsing
     size_t lastDot = path.find_last_of(".");
     size_t lastSlash = path.find_last_of("/");
@@ -21,32 +23,43 @@ void processSingleFile(const string& path) {
     string filename = path.substr(start, lastDot - start);
 
     std::ifstream input(path);
-    std::ofstream output(path.substr(0, lastDot) + ".vm");
+    std::ofstream output(path.substr(0, lastDot) + (bytecode ? ".vmb" : ".vm"), ios::binary);
 
-    CompilationEngine ce(input, output, filename);
+    CompilationEngine ce(input, output, filename, bytecode);
     ce.compileClass();
 }
 
-void processDirectory(const string& path) {
+void processDirectory(const string& path, bool bytecode) {
     string ext(".jack");
     for (auto &p : filesystem::recursive_directory_iterator(path)) {
         if (p.path().extension() == ext) {
-            processSingleFile(p.path().string());
+            processSingleFile(p.path().string(), bytecode);
         }
     }
 }
 
 int main(int argc, char* argv[]) {
-    if (argc <= 1) {
-        cout << "./a.out <filename>\n" << "./a.out <directory>\n";
+    string path;
+    bool bytecode = false;
+    for (int i = 1; i < argc; i++) {
+        string arg(argv[i]);
+        if (arg == "--vmb") {
+            bytecode = true;
+        } else {
+            path = arg;
+        }
+    }
+
+    if (path.empty()) {
+        cout << "./a.out [--vmb] <filename>\n" << "./a.out [--vmb] <directory>\n"
+             << "  --vmb  write binary .vmb files instead of .vm text\n";
         return 0;
     }
 
     error_code ec;
-    const string path(argv[1]);
     if (filesystem::is_directory(path, ec)) {
-        processDirectory(argv[1]);
+        processDirectory(path, bytecode);
     } else {
-        processSingleFile(path);
+        processSingleFile(path, bytecode);
     }
 }
@@ -27,8 +27,6 @@ static unordered_map<char, string> ops = {
       {'<', A_LT},
       {'&', A_AND},
       {'|', A_OR},
-      {'*', "call Math.multiply 2"},
-      {'/', "call Math.divide 2"},
 };
 
 static unordered_map<char, string> uops = {
@@ -47,46 +45,86 @@ class VMWriter {
 private:
   ofstream& output;
 
+  // .vmb output, collected until close()
+  bool bytecode;
+  BytecodeWriter vmb;
+
 public:
-    VMWriter(ofstream& output): output(output) { }
+    VMWriter(ofstream& output, bool bytecode = false): output(output), bytecode(bytecode) { }
 
     void writePush(const string& segment, int index) {
+        if (bytecode) {
+            vmb.add("push", segment, index);
+            return;
+        }
         output << "push " << segment << " " << index << "\n";
     }
 
     void writePop(const string& segment, int index) {
+        if (bytecode) {
+            vmb.add("pop", segment, index);
+            return;
+        }
         output << "pop " << segment << " " << index << "\n";
     }
 
     void writeArithmetic(const string& ari) {
+        if (bytecode) {
+            vmb.add(ari, "", 0);
+            return;
+        }
         output << ari << "\n";
     }
 
     void writeLabel(const string& label) {
+        if (bytecode) {
+            vmb.add("label", "", 0, label);
+            return;
+        }
         output << "label "<< label << "\n";
     }
 
     void writeGoto(const string& label) {
+        if (bytecode) {
+            vmb.add("goto", "", 0, label);
+            return;
+        }
         output << "goto "<< label << "\n";
     }
 
     void writeIf(const string& label) {
+        if (bytecode) {
+            vmb.add("if-goto", "", 0, label);
+            return;
+        }
         output << "if-goto "<< label << "\n";
     }
 
     void writeCall(const string& name, int nArgs) {
+        if (bytecode) {
+            vmb.add("call", "", nArgs, name);
+            return;
+        }
         output << "call "<< name << " " << nArgs << "\n";
     }
 
     void writeAlloc() {
-        output << "call Memory.alloc 1" << "\n";
+        writeCall("Memory.alloc", 1);
     }
 
     void writeFunction(const string& name, int nLocals) {
+        if (bytecode) {
+            vmb.add("function", "", nLocals, name);
+            return;
+        }
         output << "function " << name << " " << nLocals << "\n";
     }
 
     void writeReturn() {
+        if (bytecode) {
+            vmb.add("return", "", 0);
+            return;
+        }
         output << "return\n";
     }
 
@@ -95,6 +133,9 @@ public:
     }
 
     void close() {
+        if (bytecode) {
+            output << vmb.bytes();
+        }
         output.close();
     }
 };